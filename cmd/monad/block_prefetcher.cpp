@@ -0,0 +1,141 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "block_prefetcher.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/block.hpp>
+#include <category/execution/ethereum/db/block_db.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+MONAD_NAMESPACE_BEGIN
+
+BlockPrefetcher::BlockPrefetcher(
+    BlockDb const &block_db, uint64_t const begin, uint64_t const end,
+    size_t const depth)
+    : block_db_{block_db}
+    , depth_{depth}
+    , next_fetch_{begin}
+    , next_pop_{begin}
+    , end_{end}
+{
+    if (depth_ > 0) {
+        reader_ = std::jthread{
+            [this](std::stop_token const token) { read_ahead(token); }};
+    }
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+    if (reader_.joinable()) {
+        reader_.request_stop();
+        cv_.notify_all();
+        reader_.join();
+    }
+}
+
+BlockPrefetcher::Fetch
+BlockPrefetcher::read_block(uint64_t const block_num) const
+{
+    auto const begin = std::chrono::steady_clock::now();
+    Fetch fetch{};
+    PerfScope const perf{PerfStage::BodyRead, block_num};
+    fetch.found = block_db_.get(block_num, fetch.prefetched.block);
+    fetch.prefetched.read_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin);
+    return fetch;
+}
+
+void BlockPrefetcher::read_ahead(std::stop_token const token)
+{
+    // next_fetch_ is only touched by this thread once it is running. A fetch
+    // past the last block that exists is harmless: it reports the block as
+    // missing to whoever pops it
+    while (next_fetch_ <= end_) {
+        {
+            std::unique_lock lock{mutex_};
+            if (!cv_.wait(lock, token, [this] {
+                    return ready_.size() < depth_;
+                })) {
+                return;
+            }
+        }
+        Fetch f = read_block(next_fetch_++);
+        {
+            std::lock_guard const lock{mutex_};
+            ready_.push_back(std::move(f));
+        }
+        cv_.notify_all();
+    }
+}
+
+std::optional<Block> BlockPrefetcher::pop()
+{
+    uint64_t const block_num = next_pop_++;
+    if (depth_ == 0 || block_num > end_) {
+        // Read-ahead disabled or past its range, read inline
+        auto const begin = std::chrono::steady_clock::now();
+        Block block;
+        record_perf_marker(
+            PerfStage::BodyRead, PerfPhase::Begin, block_num, 0);
+        bool const found = block_db_.get(block_num, block);
+        record_perf_marker(PerfStage::BodyRead, PerfPhase::End, block_num, 0);
+        auto const elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin);
+        stall_time_ += elapsed;
+        read_time_ += elapsed;
+        exec_metrics().ingest_stall_us.add(
+            static_cast<uint64_t>(elapsed.count()));
+        exec_metrics().stage(BlockStage::Read).record(elapsed);
+        if (!found) {
+            return std::nullopt;
+        }
+        return block;
+    }
+
+    Fetch fetch;
+    auto const wait_begin = std::chrono::steady_clock::now();
+    {
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return !ready_.empty(); });
+        fetch = std::move(ready_.front());
+        ready_.pop_front();
+    }
+    cv_.notify_all();
+    auto const stall = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - wait_begin);
+    stall_time_ += stall;
+    read_time_ += fetch.prefetched.read_time;
+    exec_metrics().ingest_stall_us.add(static_cast<uint64_t>(stall.count()));
+    exec_metrics().stage(BlockStage::Read).record(fetch.prefetched.read_time);
+    if (!fetch.found) {
+        return std::nullopt;
+    }
+    MONAD_ASSERT(fetch.prefetched.block.header.number == block_num);
+    return std::move(fetch.prefetched.block);
+}
+
+MONAD_NAMESPACE_END
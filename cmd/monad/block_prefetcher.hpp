@@ -0,0 +1,101 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/block.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+
+MONAD_NAMESPACE_BEGIN
+
+class BlockDb;
+
+/// A historical block fetched, decompressed and decoded from the block db
+struct PrefetchedBlock
+{
+    Block block;
+    std::chrono::microseconds read_time;
+};
+
+/// Bounded read-ahead over consecutive block db entries. A single long-lived
+/// reader thread keeps up to `depth` blocks past the one being executed
+/// decoded and waiting, so the executor finds the next block ready. `pop`
+/// hands out blocks in ascending block number order.
+class BlockPrefetcher
+{
+    struct Fetch
+    {
+        bool found;
+        PrefetchedBlock prefetched;
+    };
+
+    BlockDb const &block_db_;
+    size_t const depth_;
+    uint64_t next_fetch_;
+    uint64_t next_pop_;
+    uint64_t const end_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::deque<Fetch> ready_;
+
+    std::chrono::microseconds stall_time_{0};
+    std::chrono::microseconds read_time_{0};
+
+    // Declared last, so the reader is joined before the state it uses is
+    // destroyed
+    std::jthread reader_;
+
+    Fetch read_block(uint64_t block_num) const;
+    void read_ahead(std::stop_token);
+
+public:
+    /// Prefetches blocks `begin` through `end` inclusive. A depth of zero
+    /// disables read-ahead: each block is read when it is popped.
+    BlockPrefetcher(
+        BlockDb const &, uint64_t begin, uint64_t end, size_t depth);
+    ~BlockPrefetcher();
+
+    BlockPrefetcher(BlockPrefetcher const &) = delete;
+    BlockPrefetcher &operator=(BlockPrefetcher const &) = delete;
+
+    /// Blocks until the next block is available and returns it, or nullopt
+    /// if the block db does not contain it
+    std::optional<Block> pop();
+
+    /// Total time `pop` spent waiting on an unfinished read
+    std::chrono::microseconds stall_time() const
+    {
+        return stall_time_;
+    }
+
+    /// Total time spent reading the popped blocks, wherever it was spent
+    std::chrono::microseconds read_time() const
+    {
+        return read_time_;
+    }
+};
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,98 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "block_scratch.hpp"
+
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+#include <category/execution/ethereum/core/transaction.hpp>
+#include <category/execution/ethereum/trace/call_tracer.hpp>
+#include <category/execution/ethereum/trace/state_tracer.hpp>
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+BlockScratch BlockScratchPool::acquire(
+    std::span<Transaction const> const transactions, bool const enable_tracing)
+{
+    size_t const n = transactions.size();
+    BlockScratch scratch;
+    std::lock_guard const lock{mutex_};
+    if (!spare_.empty()) {
+        scratch = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    scratch.tracing = enable_tracing;
+    scratch.senders.resize(n);
+    scratch.call_frames.resize(n);
+    scratch.call_tracers.reserve(n);
+    scratch.state_tracers.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (enable_tracing) {
+            scratch.call_tracers.emplace_back(std::make_unique<CallTracer>(
+                transactions[i], scratch.call_frames[i]));
+        }
+        else if (!noop_call_tracers_.empty()) {
+            scratch.call_tracers.emplace_back(
+                std::move(noop_call_tracers_.back()));
+            noop_call_tracers_.pop_back();
+        }
+        else {
+            scratch.call_tracers.emplace_back(
+                std::make_unique<NoopCallTracer>());
+        }
+
+        if (!state_tracers_.empty()) {
+            scratch.state_tracers.emplace_back(
+                std::move(state_tracers_.back()));
+            state_tracers_.pop_back();
+        }
+        else {
+            scratch.state_tracers.emplace_back(
+                std::make_unique<trace::StateTracer>(std::monostate{}));
+        }
+    }
+    return scratch;
+}
+
+void BlockScratchPool::release(BlockScratch &&scratch)
+{
+    std::lock_guard const lock{mutex_};
+    if (!scratch.tracing) {
+        for (auto &tracer : scratch.call_tracers) {
+            noop_call_tracers_.emplace_back(std::move(tracer));
+        }
+    }
+    for (auto &tracer : scratch.state_tracers) {
+        *tracer = trace::StateTracer{std::monostate{}};
+        state_tracers_.emplace_back(std::move(tracer));
+    }
+    // Only outer buffers are kept: with tracing disabled the per transaction
+    // frame vectors never allocated, with it enabled the frames recorded by
+    // the call tracers are dropped here
+    scratch.senders.clear();
+    scratch.call_tracers.clear();
+    scratch.state_tracers.clear();
+    scratch.call_frames.clear();
+    spare_.emplace_back(std::move(scratch));
+}
+
+MONAD_NAMESPACE_END
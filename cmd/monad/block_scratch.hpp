@@ -0,0 +1,64 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+#include <category/execution/ethereum/core/transaction.hpp>
+#include <category/execution/ethereum/trace/call_tracer.hpp>
+#include <category/execution/ethereum/trace/state_tracer.hpp>
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Per-block containers that live from sender recovery until the block has
+/// committed: the recovered senders, and the per-transaction tracers and call
+/// frame buffers handed to execute_block
+struct BlockScratch
+{
+    std::vector<Address> senders;
+    std::vector<std::vector<CallFrame>> call_frames;
+    std::vector<std::unique_ptr<CallTracerBase>> call_tracers;
+    std::vector<std::unique_ptr<trace::StateTracer>> state_tracers;
+    bool tracing{false};
+};
+
+/// Recycles per-block scratch between blocks. Returned containers are cleared
+/// but keep their capacity, and with tracing disabled every transaction gets
+/// a recycled NoopCallTracer and empty StateTracer. Once the pool has seen a
+/// block of a given size, setting up another one allocates nothing. Call
+/// tracers bound to a transaction are never recycled.
+class BlockScratchPool
+{
+    std::mutex mutex_;
+    std::vector<BlockScratch> spare_;
+    std::vector<std::unique_ptr<CallTracerBase>> noop_call_tracers_;
+    std::vector<std::unique_ptr<trace::StateTracer>> state_tracers_;
+
+public:
+    /// Scratch sized for `transactions`; `senders` is sized but unset
+    BlockScratch
+    acquire(std::span<Transaction const> transactions, bool enable_tracing);
+
+    /// Returns the scratch of a block once it has committed
+    void release(BlockScratch &&);
+};
+
+MONAD_NAMESPACE_END
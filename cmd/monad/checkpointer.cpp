@@ -0,0 +1,156 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "checkpointer.hpp"
+#include "metrics.hpp"
+
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/db/db_snapshot.h>
+#include <category/execution/ethereum/db/db_snapshot_filesystem.h>
+
+#include <quill/Quill.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+Checkpointer::Checkpointer(
+    std::vector<std::filesystem::path> dbname_paths,
+    std::filesystem::path dir, uint64_t const interval,
+    uint64_t const history_length, std::optional<unsigned> const sq_thread_cpu)
+    : dbname_paths_{std::move(dbname_paths)}
+    , dir_{std::move(dir)}
+    , interval_{interval}
+    , history_length_{history_length}
+    , sq_thread_cpu_{sq_thread_cpu}
+{
+    std::filesystem::create_directories(dir_);
+}
+
+Checkpointer::~Checkpointer()
+{
+    if (pending_.valid()) {
+        LOG_INFO("Waiting for the checkpoint in progress to complete");
+        wait();
+    }
+}
+
+bool Checkpointer::dump(uint64_t const block_number) const
+{
+    auto const begin = std::chrono::steady_clock::now();
+    auto const path = dir_ / std::to_string(block_number);
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    std::filesystem::remove_all(tmp_path);
+
+    std::vector<char const *> c_dbname_paths;
+    for (auto const &dbname_path : dbname_paths_) {
+        c_dbname_paths.emplace_back(dbname_path.c_str());
+    }
+    auto *const context =
+        monad_db_snapshot_filesystem_write_user_context_create(
+            tmp_path.c_str(), block_number);
+    bool const success = monad_db_dump_snapshot(
+        c_dbname_paths.data(),
+        c_dbname_paths.size(),
+        sq_thread_cpu_.value_or(std::numeric_limits<unsigned>::max()),
+        block_number,
+        monad_db_snapshot_write_filesystem,
+        context);
+    monad_db_snapshot_filesystem_write_user_context_destroy(context);
+
+    if (!success) {
+        LOG_ERROR("Checkpoint of block {} failed", block_number);
+        std::filesystem::remove_all(tmp_path);
+        return false;
+    }
+    std::filesystem::remove_all(path);
+    std::filesystem::rename(tmp_path, path);
+    LOG_INFO(
+        "Checkpoint of block {} written to {} in {}",
+        block_number,
+        path,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin));
+    return true;
+}
+
+void Checkpointer::wait()
+{
+    bool success = false;
+    try {
+        success = pending_.get();
+    }
+    catch (std::exception const &e) {
+        LOG_ERROR("Checkpoint of block {} failed: {}", dumping_, e.what());
+    }
+    if (success) {
+        exec_metrics().checkpoint_block_number.set(
+            static_cast<int64_t>(dumping_));
+    }
+    else {
+        exec_metrics().checkpoint_failures.add(1);
+    }
+}
+
+void Checkpointer::on_finalized(uint64_t const block_number)
+{
+    if (pending_.valid() && pending_.wait_for(std::chrono::seconds{0}) ==
+                                std::future_status::ready) {
+        wait();
+    }
+    if (block_number % interval_ == 0) {
+        if (pending_.valid()) {
+            LOG_WARNING(
+                "Skipping checkpoint of block {}, the previous one is still "
+                "being written",
+                block_number);
+            exec_metrics().checkpoints_skipped.add(1);
+        }
+        else {
+            dumping_ = block_number;
+            pending_ = std::async(std::launch::async, [this, block_number] {
+                return dump(block_number);
+            });
+        }
+    }
+    // Committing the next block prunes every version older than
+    // block_number + 2 - history_length
+    if (pending_.valid() && block_number + 2 > dumping_ + history_length_) {
+        LOG_WARNING(
+            "Pausing execution after block {} until the checkpoint of block "
+            "{} completes",
+            block_number,
+            dumping_);
+        auto const begin = std::chrono::steady_clock::now();
+        wait();
+        exec_metrics().checkpoint_pause_us.add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin)
+                .count()));
+    }
+}
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,69 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <category/core/config.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Takes a binary snapshot of the db every `interval` finalized blocks while
+/// execution carries on. The dump runs on a background thread through its
+/// own read-only handle on the db files, at the version that was just
+/// finalized, so the executor only pays for starting it. The db keeps the
+/// last `history_length` versions, so the executor is paused before the
+/// block that would prune the version being dumped until the dump is done.
+/// Snapshots are written to `dir`/<block>.tmp and renamed to `dir`/<block>
+/// once complete. A snapshot that falls due while the previous one is still
+/// being written is skipped. Skips and failures are logged and counted in
+/// the execution metrics.
+class Checkpointer
+{
+    std::vector<std::filesystem::path> const dbname_paths_;
+    std::filesystem::path const dir_;
+    uint64_t const interval_;
+    uint64_t const history_length_;
+    std::optional<unsigned> const sq_thread_cpu_;
+    uint64_t dumping_{0};
+    std::future<bool> pending_;
+
+    bool dump(uint64_t block_number) const;
+    void wait();
+
+public:
+    Checkpointer(
+        std::vector<std::filesystem::path> dbname_paths,
+        std::filesystem::path dir, uint64_t interval, uint64_t history_length,
+        std::optional<unsigned> sq_thread_cpu);
+
+    /// Waits for the snapshot in progress, if any
+    ~Checkpointer();
+
+    Checkpointer(Checkpointer const &) = delete;
+    Checkpointer &operator=(Checkpointer const &) = delete;
+
+    /// Called once `block_number` is committed and finalized, before the
+    /// next block is executed
+    void on_finalized(uint64_t block_number);
+};
+
+MONAD_NAMESPACE_END
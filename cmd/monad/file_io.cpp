@@ -14,42 +14,172 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "file_io.hpp"
+#include "perf_timeline.hpp"
 
 #include <category/core/assert.h>
-#include <category/core/blake3.hpp>
+#include <category/core/cleanup.h>
 #include <category/execution/ethereum/core/fmt/bytes_fmt.hpp>
+#include <category/execution/monad/chain/monad_chain.hpp>
 #include <category/execution/monad/core/rlp/monad_block_rlp.hpp>
+#include <category/vm/evm/switch_traits.hpp>
+#include <category/vm/evm/traits.hpp>
 
+#include <blake3.h>
 #include <evmc/evmc.hpp>
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 
-MONAD_NAMESPACE_BEGIN
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-byte_string read_file(bytes32_t const &id, std::filesystem::path const &dir)
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Files are read in chunks of this size, so that a chunk can be handed to
+// `on_chunk` (e.g., the checksum) while it is still hot in cache
+constexpr size_t READ_CHUNK_SIZE = 1UL << 20;
+
+template <class Fn>
+byte_string_view read_chunked(
+    std::filesystem::path const &path, byte_string &buf, Fn &&on_chunk)
 {
-    std::string const filename = evmc::hex(id);
-    std::filesystem::path const path = dir / filename;
+    int fd [[gnu::cleanup(cleanup_close)]] =
+        open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    MONAD_ASSERT_PRINTF(
+        fd != -1, "open %s failed: %s", path.c_str(), strerror(errno));
+    struct stat st;
     MONAD_ASSERT_PRINTF(
-        std::filesystem::exists(path) && std::filesystem::is_regular_file(path),
+        fstat(fd, &st) == 0 && S_ISREG(st.st_mode),
         "missing or bad file %s",
         path.c_str());
-    std::ifstream is(path);
-    MONAD_ASSERT(is);
-    byte_string const data{
-        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
-    auto const checksum = to_bytes(blake3(data));
+    auto const size = static_cast<size_t>(st.st_size);
+    if (size > READ_CHUNK_SIZE) {
+        // Let the kernel read ahead the rest of the file while we process
+        // the first chunks
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+    buf.resize_and_overwrite(
+        size, [fd, &path, &on_chunk](uint8_t *const data, size_t const n) {
+            size_t off = 0;
+            while (off < n) {
+                size_t const len = std::min(READ_CHUNK_SIZE, n - off);
+                size_t done = 0;
+                while (done < len) {
+                    ssize_t const r = pread(
+                        fd,
+                        data + off + done,
+                        len - done,
+                        static_cast<off_t>(off + done));
+                    if (r == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    MONAD_ASSERT_PRINTF(
+                        r > 0,
+                        "read %s failed: %s",
+                        path.c_str(),
+                        r == 0 ? "unexpected end of file" : strerror(errno));
+                    done += static_cast<size_t>(r);
+                }
+                on_chunk(data + off, len);
+                off += len;
+            }
+            return n;
+        });
+    return byte_string_view{buf};
+}
+
+template <class MonadConsensusBlockHeader>
+ConsensusHeader decode_header(bytes32_t const &id, byte_string_view data)
+{
+    auto const header_res =
+        rlp::decode_consensus_block_header<MonadConsensusBlockHeader>(data);
+    MONAD_ASSERT_PRINTF(
+        !header_res.has_error(),
+        "Could not rlp decode header: %s",
+        evmc::hex(id).c_str());
+    return header_res.value();
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+byte_string_view
+read_whole_file(std::filesystem::path const &path, byte_string &buf)
+{
+    return read_chunked(path, buf, [](uint8_t const *, size_t) {});
+}
+
+byte_string_view read_checked_file(
+    std::filesystem::path const &path, bytes32_t const &checksum,
+    byte_string &buf)
+{
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    byte_string_view const data =
+        read_chunked(path, buf, [&hasher](uint8_t const *chunk, size_t len) {
+            blake3_hasher_update(&hasher, chunk, len);
+        });
+    bytes32_t actual;
+    blake3_hasher_finalize(&hasher, actual.bytes, sizeof(actual.bytes));
     MONAD_ASSERT_PRINTF(
-        checksum == id, "Checksum failed for file: %s", path.c_str());
+        actual == checksum, "Checksum failed for file: %s", path.c_str());
     return data;
 }
 
-MonadConsensusBlockBody
-read_body(bytes32_t const &id, std::filesystem::path const &dir)
+byte_string_view read_file(
+    bytes32_t const &id, std::filesystem::path const &dir, byte_string &buf)
+{
+    return read_checked_file(dir / evmc::hex(id), id, buf);
+}
+
+byte_string read_file(bytes32_t const &id, std::filesystem::path const &dir)
 {
-    auto const data = read_file(id, dir);
+    byte_string buf;
+    read_file(id, dir, buf);
+    return buf;
+}
+
+ConsensusHeader read_header(
+    bytes32_t const &id, std::filesystem::path const &dir,
+    MonadChain const &chain, byte_string &buf)
+{
+    byte_string_view const data = read_file(id, dir, buf);
     byte_string_view view{data};
+    auto const ts = rlp::decode_consensus_block_header_timestamp_s(view);
+    MONAD_ASSERT_PRINTF(
+        !ts.has_error(),
+        "Could not rlp decode timestamp from header: %s",
+        evmc::hex(id).c_str());
+    auto const rev = chain.get_monad_revision(ts.value());
+
+    auto const decode = [&]<Traits traits> -> ConsensusHeader {
+        if constexpr (traits::monad_rev() >= MONAD_FOUR) {
+            return decode_header<MonadConsensusBlockHeaderV2>(id, data);
+        }
+        else if constexpr (traits::monad_rev() >= MONAD_THREE) {
+            return decode_header<MonadConsensusBlockHeaderV1>(id, data);
+        }
+        else {
+            return decode_header<MonadConsensusBlockHeaderV0>(id, data);
+        }
+    };
+    SWITCH_MONAD_TRAITS(decode.template operator());
+    MONAD_ABORT_PRINTF("unhandled rev switch case: %d", rev);
+}
+
+MonadConsensusBlockBody read_body(
+    bytes32_t const &id, std::filesystem::path const &dir, byte_string &buf)
+{
+    record_perf_marker(PerfStage::BodyRead, PerfPhase::Begin, 0, perf_id(id));
+    byte_string_view view = read_file(id, dir, buf);
+    record_perf_marker(PerfStage::BodyRead, PerfPhase::End, 0, perf_id(id));
+    PerfScope const perf{PerfStage::Decode, 0, perf_id(id)};
     auto const res = rlp::decode_consensus_block_body(view);
     MONAD_ASSERT_PRINTF(
         !res.has_error(),
@@ -58,6 +188,13 @@ read_body(bytes32_t const &id, std::filesystem::path const &dir)
     return res.value();
 }
 
+MonadConsensusBlockBody
+read_body(bytes32_t const &id, std::filesystem::path const &dir)
+{
+    byte_string buf;
+    return read_body(id, dir, buf);
+}
+
 bytes32_t head_pointer_to_id(std::filesystem::path const &symlink)
 {
     char resolved[PATH_MAX] = {};
@@ -21,11 +21,41 @@
 #include <category/execution/monad/core/monad_block.hpp>
 
 #include <filesystem>
+#include <variant>
 
 MONAD_NAMESPACE_BEGIN
 
+struct MonadChain;
+
+using ConsensusHeader = std::variant<
+    MonadConsensusBlockHeaderV0, MonadConsensusBlockHeaderV1,
+    MonadConsensusBlockHeaderV2>;
+
+/// Read the whole regular file at `path` into `buf` with a single fstat and
+/// pread, reusing the existing capacity of `buf`. Returns a view of `buf`.
+byte_string_view read_whole_file(std::filesystem::path const &, byte_string &);
+
+/// Like `read_whole_file`, but hashes the file with blake3 chunk by chunk as
+/// it is read, and asserts that the result equals `checksum`
+byte_string_view read_checked_file(
+    std::filesystem::path const &, bytes32_t const &checksum, byte_string &);
+
+/// Read the ledger file named by `id` from `dir` into `buf` and verify that
+/// its blake3 checksum matches `id`. Returns a view of `buf`.
+byte_string_view
+read_file(bytes32_t const &, std::filesystem::path const &, byte_string &);
+
 byte_string read_file(bytes32_t const &, std::filesystem::path const &);
 
+/// Read and checksum the header named by `id` from `dir`, and decode it as
+/// the header version of the monad revision in force at its timestamp
+ConsensusHeader read_header(
+    bytes32_t const &, std::filesystem::path const &, MonadChain const &,
+    byte_string &);
+
+MonadConsensusBlockBody
+read_body(bytes32_t const &, std::filesystem::path const &, byte_string &);
+
 MonadConsensusBlockBody
 read_body(bytes32_t const &, std::filesystem::path const &);
 
@@ -0,0 +1,204 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "ingest_pipeline.hpp"
+#include "file_io.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/byte_string.hpp>
+#include <category/core/config.hpp>
+#include <category/core/fiber/priority_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <utility>
+
+MONAD_NAMESPACE_BEGIN
+
+IngestPipeline::IngestPipeline(
+    std::filesystem::path body_dir, fiber::PriorityPool &priority_pool,
+    SenderCache &sender_cache, size_t const depth)
+    : body_dir_{std::move(body_dir)}
+    , priority_pool_{priority_pool}
+    , sender_cache_{sender_cache}
+    , depth_{std::max(depth, size_t{1})}
+{
+    for (size_t i = 0; i < depth_; ++i) {
+        workers_.emplace_back(
+            [this](std::stop_token const token) { work(token); });
+    }
+}
+
+IngestPipeline::~IngestPipeline()
+{
+    for (auto &worker : workers_) {
+        worker.request_stop();
+    }
+    cv_.notify_all();
+    workers_.clear();
+}
+
+IngestedBlock
+IngestPipeline::ingest(bytes32_t const &body_id, byte_string &buf)
+{
+    ++reading_;
+    auto const read_begin = std::chrono::steady_clock::now();
+    auto body = read_body(body_id, body_dir_, buf);
+    auto const recovery_begin = std::chrono::steady_clock::now();
+    --reading_;
+
+    ++recovering_;
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::Begin, 0, perf_id(body_id));
+    auto recovered = recover_senders_and_authorities(
+        body.transactions, priority_pool_, sender_cache_);
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::End, 0, perf_id(body_id));
+    auto const recovery_end = std::chrono::steady_clock::now();
+    --recovering_;
+
+    return IngestedBlock{
+        .body = std::move(body),
+        .recovered = std::move(recovered),
+        .read_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            recovery_begin - read_begin),
+        .sender_recovery_time =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                recovery_end - recovery_begin)};
+}
+
+bool IngestPipeline::can_start() const
+{
+    if (queued_.empty()) {
+        return false;
+    }
+    // Bodies queued far ahead of execution wait for the executor to consume
+    // what is ready, but never the one it is waiting on
+    return in_flight_ + ready_ < depth_ || queued_.front() == wanted_;
+}
+
+void IngestPipeline::work(std::stop_token const token)
+{
+    // Each worker keeps its read buffer, so large bodies do not cost a fresh
+    // allocation per block
+    byte_string buf;
+    std::unique_lock lock{mutex_};
+    while (cv_.wait(lock, token, [this] { return can_start(); })) {
+        bytes32_t const body_id = queued_.front();
+        queued_.pop_front();
+        slots_.at(body_id).started = true;
+        ++in_flight_;
+        lock.unlock();
+        IngestedBlock block = ingest(body_id, buf);
+        lock.lock();
+        --in_flight_;
+        // The slot may have been discarded while the body was ingested
+        if (auto const it = slots_.find(body_id); it != slots_.end()) {
+            it->second.result.emplace(std::move(block));
+            ++ready_;
+        }
+        cv_.notify_all();
+    }
+}
+
+void IngestPipeline::push(bytes32_t const &body_id, uint64_t const block_number)
+{
+    {
+        std::lock_guard const lock{mutex_};
+        if (!slots_.try_emplace(body_id, Slot{.block_number = block_number})
+                 .second) {
+            return;
+        }
+        queued_.push_back(body_id);
+    }
+    cv_.notify_all();
+}
+
+IngestedBlock
+IngestPipeline::pop(bytes32_t const &body_id, uint64_t const block_number)
+{
+    std::unique_lock lock{mutex_};
+    auto [it, inserted] =
+        slots_.try_emplace(body_id, Slot{.block_number = block_number});
+    if (!it->second.started) {
+        // Whatever was pushed ahead of it, this is what execution needs now
+        if (!inserted) {
+            std::erase(queued_, body_id);
+        }
+        queued_.push_front(body_id);
+        wanted_ = body_id;
+        cv_.notify_all();
+    }
+    auto const wait_begin = std::chrono::steady_clock::now();
+    cv_.wait(lock, [this, &body_id] {
+        return slots_.at(body_id).result.has_value();
+    });
+    auto const stall = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - wait_begin);
+    stall_time_ += stall;
+    IngestedBlock block = std::move(slots_.at(body_id).result.value());
+    slots_.erase(body_id);
+    --ready_;
+    wanted_.reset();
+    lock.unlock();
+    // A slot is free for the next queued body
+    cv_.notify_all();
+
+    exec_metrics().ingest_stall_us.add(static_cast<uint64_t>(stall.count()));
+    exec_metrics().stage(BlockStage::Read).record(block.read_time);
+    return block;
+}
+
+void IngestPipeline::discard_through(uint64_t const block_number)
+{
+    {
+        std::lock_guard const lock{mutex_};
+        std::erase_if(queued_, [this, block_number](bytes32_t const &id) {
+            return slots_.at(id).block_number <= block_number;
+        });
+        // Started slots without a result stay until their worker is done, as
+        // nothing else would tell it the body is unwanted
+        std::erase_if(slots_, [this, block_number](auto const &entry) {
+            Slot const &slot = entry.second;
+            if (slot.block_number > block_number ||
+                (slot.started && !slot.result.has_value())) {
+                return false;
+            }
+            if (slot.result.has_value()) {
+                --ready_;
+            }
+            return true;
+        });
+    }
+    cv_.notify_all();
+}
+
+IngestPipelineDepths IngestPipeline::depths()
+{
+    std::lock_guard const lock{mutex_};
+    return IngestPipelineDepths{
+        .queued = queued_.size(),
+        .reading = reading_.load(std::memory_order_relaxed),
+        .recovering = recovering_.load(std::memory_order_relaxed),
+        .ready = ready_};
+}
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,138 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "sender_cache.hpp"
+
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/execution/monad/core/monad_block.hpp>
+
+#include <ankerl/unordered_dense.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+namespace fiber
+{
+    class PriorityPool;
+}
+
+/// A consensus block body that has been read from the ledger, checksummed,
+/// decoded and had its transaction senders and EIP-7702 authorities recovered
+struct IngestedBlock
+{
+    MonadConsensusBlockBody body;
+    RecoveredSenders recovered;
+    std::chrono::microseconds read_time;
+    std::chrono::microseconds sender_recovery_time;
+};
+
+/// Snapshot of the number of blocks sitting in each pipeline stage
+struct IngestPipelineDepths
+{
+    size_t queued; ///< pushed, ingest not yet started
+    size_t reading; ///< body read, checksum and rlp decode in progress
+    size_t recovering; ///< sender and authority recovery in progress
+    size_t ready; ///< fully ingested, waiting for the executor
+};
+
+/// Staged ingest pipeline for the monad runloop. Bodies are pushed as soon as
+/// their headers are discovered and ingested, oldest first, by `depth`
+/// long-lived worker threads while the executor works on other blocks. At
+/// most `depth` bodies are in progress or ready at any time; the body the
+/// executor is waiting on is always started.
+/// Results are keyed by body id and outlive the discovery batch that pushed
+/// them, so a body discovered in one iteration of the runloop and executed
+/// in a later one is only ingested once.
+class IngestPipeline
+{
+    struct Slot
+    {
+        uint64_t block_number;
+        bool started{false};
+        std::optional<IngestedBlock> result{};
+    };
+
+    std::filesystem::path const body_dir_;
+    fiber::PriorityPool &priority_pool_;
+    SenderCache &sender_cache_;
+    size_t const depth_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::deque<bytes32_t> queued_;
+    ankerl::unordered_dense::segmented_map<bytes32_t, Slot> slots_;
+    size_t in_flight_{0};
+    size_t ready_{0};
+    std::optional<bytes32_t> wanted_;
+
+    std::atomic<size_t> reading_{0};
+    std::atomic<size_t> recovering_{0};
+    std::chrono::microseconds stall_time_{0};
+
+    // Declared last, so the workers are joined before the state they use is
+    // destroyed
+    std::vector<std::jthread> workers_;
+
+    IngestedBlock ingest(bytes32_t const &body_id, byte_string &buf);
+    bool can_start() const;
+    void work(std::stop_token);
+
+public:
+    IngestPipeline(
+        std::filesystem::path body_dir, fiber::PriorityPool &, SenderCache &,
+        size_t depth);
+    ~IngestPipeline();
+
+    IngestPipeline(IngestPipeline const &) = delete;
+    IngestPipeline &operator=(IngestPipeline const &) = delete;
+
+    /// Queues a body for ingest; pushing a body that is already queued,
+    /// in progress or ready is a no-op
+    void push(bytes32_t const &body_id, uint64_t block_number);
+
+    /// Blocks until `body_id` is fully ingested and hands it out, moving it
+    /// to the front of the queue if its ingest has not started yet
+    IngestedBlock pop(bytes32_t const &body_id, uint64_t block_number);
+
+    /// Drops queued and ready bodies of blocks at or below `block_number`,
+    /// which will not be executed any more
+    void discard_through(uint64_t block_number);
+
+    IngestPipelineDepths depths();
+
+    /// Total time `pop` spent waiting on an unfinished ingest
+    std::chrono::microseconds stall_time() const
+    {
+        return stall_time_;
+    }
+};
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,105 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ledger_watcher.hpp"
+
+#include <category/core/config.hpp>
+
+#include <quill/Quill.h>
+
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+MONAD_NAMESPACE_BEGIN
+
+LedgerWatcher::LedgerWatcher(
+    std::filesystem::path const &header_dir,
+    std::chrono::milliseconds const fallback_poll_interval,
+    std::filesystem::path const &wal)
+    : fallback_poll_interval_{fallback_poll_interval}
+{
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ == -1) {
+        LOG_WARNING(
+            "inotify_init1 failed: {}, falling back to polling the ledger",
+            strerror(errno));
+        return;
+    }
+    // Consensus writes headers under a temporary name and renames them into
+    // place, and updates the head symlinks the same way
+    if (inotify_add_watch(
+            inotify_fd_,
+            header_dir.c_str(),
+            IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE) == -1) {
+        LOG_WARNING(
+            "inotify_add_watch on {} failed: {}, falling back to polling the "
+            "ledger",
+            header_dir.c_str(),
+            strerror(errno));
+        (void)close(inotify_fd_);
+        inotify_fd_ = -1;
+        return;
+    }
+    // The WAL is appended to in place. Its entries follow the header writes
+    // above, so a failed watch costs latency, not correctness.
+    if (!wal.empty() &&
+        inotify_add_watch(inotify_fd_, wal.c_str(), IN_MODIFY) == -1) {
+        LOG_WARNING(
+            "inotify_add_watch on {} failed: {}, WAL appends will only be "
+            "noticed through header writes",
+            wal.c_str(),
+            strerror(errno));
+    }
+}
+
+LedgerWatcher::~LedgerWatcher()
+{
+    if (inotify_fd_ != -1) {
+        (void)close(inotify_fd_);
+    }
+}
+
+bool LedgerWatcher::wait()
+{
+    if (inotify_fd_ == -1) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return false;
+    }
+
+    pollfd pfd{.fd = inotify_fd_, .events = POLLIN, .revents = 0};
+    int const rc =
+        poll(&pfd, 1, static_cast<int>(fallback_poll_interval_.count()));
+    if (rc <= 0) {
+        // Timeout, or EINTR from a signal; either way the caller re-scans
+        // the ledger and checks whether it was asked to stop
+        return false;
+    }
+
+    // Drain every queued event; the caller re-scans the ledger from the head
+    // pointers, so the individual events carry no extra information
+    alignas(inotify_event) char buf[4096];
+    while (read(inotify_fd_, buf, sizeof(buf)) > 0) {
+    }
+    return true;
+}
+
+MONAD_NAMESPACE_END
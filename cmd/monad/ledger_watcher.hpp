@@ -0,0 +1,49 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/config.hpp>
+
+#include <chrono>
+#include <filesystem>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Watches the ledger header directory with inotify so the runloop can sleep
+/// until consensus writes a new header or moves one of the head symlinks.
+/// When given the consensus WAL, appends to it wake the runloop too. If
+/// inotify is unavailable, `wait` degrades to a short sleep.
+class LedgerWatcher
+{
+    int inotify_fd_{-1};
+    std::chrono::milliseconds const fallback_poll_interval_;
+
+public:
+    LedgerWatcher(
+        std::filesystem::path const &header_dir,
+        std::chrono::milliseconds fallback_poll_interval,
+        std::filesystem::path const &wal = {});
+    ~LedgerWatcher();
+
+    LedgerWatcher(LedgerWatcher const &) = delete;
+    LedgerWatcher &operator=(LedgerWatcher const &) = delete;
+
+    /// Block until the header directory or the WAL changes or the fallback
+    /// poll interval elapses. Returns true if woken by a change notification.
+    bool wait();
+};
+
+MONAD_NAMESPACE_END
@@ -13,10 +13,17 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "checkpointer.hpp"
 #include "event.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
 #include "runloop_ethereum.hpp"
 #include "runloop_monad.hpp"
 #include "runloop_monad_ethblocks.hpp"
+#include "sender_cache.hpp"
+#include "snapshot_io.hpp"
+#include "state_diff.hpp"
+#include "state_dump.hpp"
 
 #include <category/core/assert.h>
 #include <category/core/basic_formatter.hpp>
@@ -62,7 +69,9 @@
 #include <cstdlib>
 #include <exception>
 #include <filesystem>
+#include <istream>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <signal.h>
 #include <stdexcept>
@@ -133,7 +142,21 @@ try {
     std::optional<unsigned> ro_sq_thread_cpu;
     std::vector<fs::path> dbname_paths;
     fs::path snapshot;
+    std::vector<fs::path> snapshot_diffs;
     fs::path dump_snapshot;
+    unsigned dump_snapshot_threads = 4;
+    size_t sender_cache_size = 1UL << 20;
+    fs::path sender_cache_file;
+    fs::path senders_checkpoint;
+    fs::path wal_position;
+    size_t prefetch_blocks = 8;
+    bool overlap_prepare = false;
+    uint64_t checkpoint_every = 0;
+    fs::path checkpoint_dir;
+    fs::path metrics_file;
+    unsigned metrics_interval_ms = 1000;
+    unsigned latency_window_s = 60;
+    fs::path perf_timeline;
     std::string statesync;
     auto log_level = quill::LogLevel::Info;
 
@@ -173,7 +196,67 @@ try {
     cli.add_option(
         "--dump_snapshot",
         dump_snapshot,
-        "directory to dump state to at the end of run");
+        "directory to dump state to at the end of run, as newline "
+        "delimited JSON");
+    cli.add_option(
+        "--dump_snapshot_threads",
+        dump_snapshot_threads,
+        "number of threads, each with its own read-only db, that dump state "
+        "for --dump_snapshot");
+    cli.add_option(
+        "--sender_cache_size",
+        sender_cache_size,
+        "number of transactions whose recovered senders and authorities are "
+        "cached");
+    cli.add_option(
+        "--sender_cache_file",
+        sender_cache_file,
+        "file to load the sender cache from at startup and save it to at "
+        "shutdown (optional)");
+    cli.add_option(
+        "--senders_checkpoint",
+        senders_checkpoint,
+        "file to persist the senders and authorities of the last two "
+        "executed blocks in, so that a monad restart does not recover them "
+        "again (optional)");
+    cli.add_option(
+        "--wal_position",
+        wal_position,
+        "file recording how far into the consensus WAL execution has got. "
+        "If set, new monad blocks are found by tailing the WAL rather than "
+        "by walking the header chain (optional)");
+    cli.add_option(
+        "--prefetch_blocks",
+        prefetch_blocks,
+        "number of historical blocks read ahead of execution from the block "
+        "db (ethereum replay only, 0 disables read-ahead)");
+    cli.add_flag(
+        "--overlap_prepare",
+        overlap_prepare,
+        "read and recover senders for the next block while the current one "
+        "commits; the commit itself stays synchronous (ethereum replay "
+        "only)");
+    cli.add_option(
+        "--metrics_file",
+        metrics_file,
+        "file to periodically write execution metrics to, in the OpenMetrics "
+        "text format (optional)");
+    cli.add_option(
+           "--metrics_interval_ms",
+           metrics_interval_ms,
+           "interval between rewrites of the metrics file")
+        ->check(CLI::PositiveNumber);
+    cli.add_option(
+           "--latency_window_s",
+           latency_window_s,
+           "sliding window over which per stage latency percentiles are "
+           "logged and exported, advanced in sixths")
+        ->check(CLI::PositiveNumber);
+    cli.add_option(
+        "--perf_timeline",
+        perf_timeline,
+        "shared memory file to record TSC-stamped block processing stage "
+        "markers into (optional)");
     cli.add_flag("--trace_calls", trace_calls, "enable call tracing");
     cli.add_flag(
         "--as_eth_blocks", as_eth_blocks, "ingest monad blocks in evm format");
@@ -195,6 +278,28 @@ try {
     group->add_option(
         "--statesync", statesync, "socket for statesync communication");
     group->require_option(0, 1);
+    cli.add_option(
+           "--snapshot_diff",
+           snapshot_diffs,
+           "state diff directories written by monad_cli --dump_state_diff, "
+           "applied in order on top of the loaded db. Ethereum chains only, "
+           "with the headers taken from --block_db; the applied blocks are "
+           "committed without their transactions and receipts, so only "
+           "execution from the last target onwards is supported")
+        ->check(CLI::ExistingDirectory);
+    auto *const checkpoint_every_option = cli.add_option(
+        "--checkpoint_every",
+        checkpoint_every,
+        "write a binary snapshot of the db every N blocks of an ethereum "
+        "replay, in the background while execution continues. Execution "
+        "pauses if it would otherwise prune the version being written. "
+        "Restart from one with monad_cli --load_binary_snapshot");
+    cli.add_option(
+           "--checkpoint_dir",
+           checkpoint_dir,
+           "directory to write --checkpoint_every snapshots into")
+        ->needs(checkpoint_every_option);
+    checkpoint_every_option->needs("--checkpoint_dir");
     CLI::Option const *const exec_event_ring_option =
         cli.add_option(
                "--exec-event-ring",
@@ -254,6 +359,15 @@ try {
         }
     }
 
+    if (!perf_timeline.empty() &&
+        init_perf_timeline(
+            perf_timeline, DEFAULT_PERF_TIMELINE_CAPACITY_SHIFT) != 0) {
+        LOG_ERROR(
+            "cannot continue without perf timeline `{}`",
+            perf_timeline.string());
+        return 1;
+    }
+
 #ifdef ENABLE_EVENT_TRACING
     quill::FileHandlerConfig handler_cfg;
     handler_cfg.set_pattern("%(message)", "");
@@ -314,10 +428,20 @@ try {
                     "can not load checkpoint into non-empty database");
             }
             LOG_INFO("Loading from binary checkpoint in {}", snapshot);
-            std::ifstream accounts(snapshot / "accounts");
-            std::ifstream code(snapshot / "code");
+            ReadaheadStreambuf accounts_buf{snapshot / "accounts"};
+            ReadaheadStreambuf code_buf{snapshot / "code"};
+            std::istream accounts(&accounts_buf);
+            std::istream code(&code_buf);
             auto const n = std::stoul(snapshot.stem());
-            auto root = load_from_binary(db, accounts, code, n);
+            auto root = [&] {
+                SnapshotProgress const progress{
+                    "Loading snapshot",
+                    [&accounts_buf, &code_buf] {
+                        return accounts_buf.consumed() + code_buf.consumed();
+                    },
+                    accounts_buf.size() + code_buf.size()};
+                return load_from_binary(db, accounts, code, n);
+            }();
             // load the eth header for snapshot
             BlockDb block_db{block_db_path};
             Block block;
@@ -332,6 +456,16 @@ try {
             GenesisState const genesis_state = chain->get_genesis_state();
             load_genesis_state(genesis_state, triedb);
         }
+        if (!snapshot_diffs.empty()) {
+            if (chain_config != CHAIN_CONFIG_ETHEREUM_MAINNET) {
+                throw std::runtime_error(
+                    "--snapshot_diff needs an ethereum chain");
+            }
+            BlockDb const block_db{block_db_path};
+            for (auto const &diff : snapshot_diffs) {
+                apply_state_diff(triedb, block_db, diff);
+            }
+        }
         return triedb.get_block_number();
     }();
 
@@ -366,6 +500,16 @@ try {
 
     fiber::PriorityPool priority_pool{nthreads, nfibers};
 
+    SenderCache sender_cache{sender_cache_size};
+    if (!sender_cache_file.empty()) {
+        sender_cache.load(sender_cache_file, chain->get_chain_id());
+    }
+
+    auto metrics_exporter = std::make_unique<MetricsExporter>(
+        metrics_file,
+        std::chrono::milliseconds{metrics_interval_ms},
+        std::chrono::seconds{latency_window_s});
+
     auto const start_time = std::chrono::steady_clock::now();
 
     BlockHashBufferFinalized block_hash_buffer;
@@ -403,6 +547,21 @@ try {
     // codes that are required to serve RPC responses that include call traces.
     vm::VM vm{!trace_calls};
 
+    std::optional<Checkpointer> checkpointer;
+    if (checkpoint_every != 0) {
+        if (db_in_memory || chain_config != CHAIN_CONFIG_ETHEREUM_MAINNET) {
+            throw std::runtime_error(
+                "--checkpoint_every needs an on disk db and an ethereum "
+                "replay");
+        }
+        checkpointer.emplace(
+            dbname_paths,
+            checkpoint_dir,
+            checkpoint_every,
+            db.get_history_length(),
+            ro_sq_thread_cpu);
+    }
+
     DbCache db_cache =
         sync_server ? DbCache{*sync_server->ctx} : DbCache{triedb};
     auto const result = [&] {
@@ -415,10 +574,14 @@ try {
                 vm,
                 block_hash_buffer,
                 priority_pool,
+                sender_cache,
                 block_num,
                 end_block_num,
                 stop,
-                trace_calls);
+                trace_calls,
+                prefetch_blocks,
+                overlap_prepare,
+                checkpointer.has_value() ? &checkpointer.value() : nullptr);
         case CHAIN_CONFIG_MONAD_DEVNET:
         case CHAIN_CONFIG_MONAD_TESTNET:
         case CHAIN_CONFIG_MONAD_MAINNET:
@@ -430,10 +593,12 @@ try {
                     vm,
                     block_hash_buffer,
                     priority_pool,
+                    sender_cache,
                     block_num,
                     end_block_num,
                     stop,
-                    trace_calls);
+                    trace_calls,
+                    senders_checkpoint);
             }
             else {
                 return runloop_monad(
@@ -444,10 +609,13 @@ try {
                     vm,
                     block_hash_buffer,
                     priority_pool,
+                    sender_cache,
                     block_num,
                     end_block_num,
                     stop,
-                    trace_calls);
+                    trace_calls,
+                    senders_checkpoint,
+                    wal_position);
             }
         }
         MONAD_ABORT_PRINTF("Unsupported chain");
@@ -482,17 +650,27 @@ try {
             vm.print_total_counts());
     }
 
+    metrics_exporter.reset();
+
+    LOG_INFO(
+        "Sender cache hits = {}, misses = {}",
+        sender_cache.hits(),
+        sender_cache.misses());
+    if (!sender_cache_file.empty()) {
+        sender_cache.save(sender_cache_file, chain->get_chain_id());
+    }
+
     sync_server.reset();
 
     if (!dump_snapshot.empty()) {
         LOG_INFO("Dump db of block: {}", block_num);
-        mpt::AsyncIOContext io_ctx(mpt::ReadOnlyOnDiskDbConfig{
-            .sq_thread_cpu = ro_sq_thread_cpu,
-            .dbname_paths = dbname_paths,
-            .concurrent_read_io_limit = 128});
-        mpt::Db db{io_ctx};
-        TrieDb ro_db{db};
-        write_to_file(ro_db.to_json(), dump_snapshot, block_num);
+        dump_state_ndjson(
+            mpt::ReadOnlyOnDiskDbConfig{
+                .sq_thread_cpu = ro_sq_thread_cpu,
+                .dbname_paths = dbname_paths,
+                .concurrent_read_io_limit = 128},
+            dump_snapshot,
+            dump_snapshot_threads);
     }
     return result.has_error() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,524 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "metrics.hpp"
+
+#include <category/core/config.hpp>
+#include <category/core/procfs/statm.h>
+
+#include <quill/Quill.h>
+#include <quill/bundled/fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+constexpr std::string_view STAGE_NAMES[] = {
+    "discovery", "read", "sender_recovery", "execution", "commit", "total"};
+
+static_assert(
+    std::size(STAGE_NAMES) == static_cast<size_t>(BlockStage::Count));
+
+constexpr double QUANTILES[] = {0.5, 0.99, 0.999};
+
+void log_percentiles(
+    std::string_view const scope, std::string_view const stage,
+    HistogramSnapshot const &h)
+{
+    if (h.count == 0) {
+        return;
+    }
+    LOG_INFO(
+        "__latency,scope={},stage={},n={},p50={},p99={},p999={},max={}",
+        scope,
+        stage,
+        h.count,
+        h.percentile(0.5),
+        h.percentile(0.99),
+        h.percentile(0.999),
+        h.max);
+}
+
+void write_counter(
+    std::ostream &os, std::string_view const name, std::string_view const help,
+    uint64_t const value)
+{
+    os << fmt::format(
+        "# TYPE {0} counter\n# HELP {0} {1}\n{0}_total {2}\n",
+        name,
+        help,
+        value);
+}
+
+void write_gauge(
+    std::ostream &os, std::string_view const name, std::string_view const help,
+    int64_t const value)
+{
+    os << fmt::format(
+        "# TYPE {0} gauge\n# HELP {0} {1}\n{0} {2}\n", name, help, value);
+}
+
+std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && s.front() == ' ') {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && s.back() == ' ') {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// The stats strings are comma separated `key=value` fields, padded for the
+// log line, e.g. ",nreads=  120,nwrites=   8"
+void parse_stats(
+    std::map<std::string, double, std::less<>> &out,
+    std::string_view const prefix, std::string_view stats)
+{
+    std::string name;
+    while (!stats.empty()) {
+        auto const comma = stats.find(',');
+        auto const field = stats.substr(0, comma);
+        stats.remove_prefix(
+            comma == std::string_view::npos ? stats.size() : comma + 1);
+        auto const eq = field.find('=');
+        if (eq == std::string_view::npos) {
+            continue;
+        }
+        auto const key = trim(field.substr(0, eq));
+        auto const value = trim(field.substr(eq + 1));
+        double v;
+        auto const [ptr, ec] =
+            std::from_chars(value.data(), value.data() + value.size(), v);
+        if (key.empty() || ec != std::errc{} ||
+            ptr != value.data() + value.size()) {
+            continue;
+        }
+        name = fmt::format("monad_exec_{}_", prefix);
+        for (char const c : key) {
+            auto const u = static_cast<unsigned char>(c);
+            name += std::isalnum(u) ? static_cast<char>(std::tolower(u)) : '_';
+        }
+        if (auto const it = out.find(name); it != out.end()) {
+            it->second = v;
+        }
+        else {
+            out.emplace(name, v);
+        }
+    }
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+void Histogram::record(std::chrono::microseconds const d)
+{
+    auto const us = static_cast<uint64_t>(std::max(d.count(), int64_t{0}));
+    buckets_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (us > max &&
+           !max_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot Histogram::drain()
+{
+    // Not a consistent cut: a sample recorded concurrently may land in this
+    // drain or the next, with its sum and max possibly split between them
+    HistogramSnapshot snapshot;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        snapshot.buckets[i] =
+            buckets_[i].exchange(0, std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sum = sum_.exchange(0, std::memory_order_relaxed);
+    snapshot.max = max_.exchange(0, std::memory_order_relaxed);
+    return snapshot;
+}
+
+size_t Histogram::bucket_index(uint64_t value)
+{
+    value = std::min(value, (uint64_t{1} << MAX_VALUE_BITS) - 1);
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    // Keep the top SUB_BUCKET_BITS + 1 bits of the value
+    auto const shift = static_cast<unsigned>(std::bit_width(value)) -
+                       (SUB_BUCKET_BITS + 1);
+    uint64_t const sub = value >> shift;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + (sub - SUB_BUCKETS);
+}
+
+uint64_t Histogram::bucket_upper_bound(size_t const i)
+{
+    if (i < SUB_BUCKETS) {
+        return i;
+    }
+    uint64_t const shift = (i - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t const sub = SUB_BUCKETS + (i - SUB_BUCKETS) % SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+HistogramSnapshot &
+HistogramSnapshot::operator+=(HistogramSnapshot const &other)
+{
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+    return *this;
+}
+
+uint64_t HistogramSnapshot::percentile(double const q) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    auto const rank = static_cast<uint64_t>(
+        std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= std::max(rank, uint64_t{1})) {
+            return std::min(Histogram::bucket_upper_bound(i), max);
+        }
+    }
+    return max;
+}
+
+uint64_t HistogramSnapshot::count_below(uint64_t const value) const
+{
+    uint64_t n = 0;
+    for (size_t i = 0;
+         i < buckets.size() && Histogram::bucket_upper_bound(i) < value;
+         ++i) {
+        n += buckets[i];
+    }
+    return n;
+}
+
+void ExecMetrics::record_block(BlockSample const &sample)
+{
+    blocks.add(1);
+    transactions.add(sample.transactions);
+    retries.add(sample.retries);
+    gas_used.add(sample.gas_used);
+    sender_cache_hits.add(sample.sender_cache_hits);
+    block_number.set(static_cast<int64_t>(sample.block_number));
+    stage(BlockStage::SenderRecovery).record(sample.sender_recovery_time);
+    stage(BlockStage::Execution).record(sample.tx_exec_time);
+    stage(BlockStage::Commit).record(sample.commit_time);
+    stage(BlockStage::Total).record(sample.block_time);
+}
+
+void ExecMetrics::record_stats(
+    std::string_view const db, std::string_view const vm_block_counts,
+    std::string_view const vm_compiler)
+{
+    if (!stats_wanted.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard const lock{stats_mutex};
+    db_stats.assign(db);
+    vm_block_stats.assign(vm_block_counts);
+    vm_compiler_stats.assign(vm_compiler);
+}
+
+void ExecMetrics::write_openmetrics(
+    std::ostream &os, StageSnapshots const &total,
+    StageSnapshots const &window) const
+{
+    write_counter(
+        os, "monad_exec_blocks", "Blocks executed", blocks.value());
+    write_counter(
+        os,
+        "monad_exec_transactions",
+        "Transactions executed",
+        transactions.value());
+    write_counter(
+        os,
+        "monad_exec_retries",
+        "Transactions re-executed after a conflict",
+        retries.value());
+    write_counter(os, "monad_exec_gas", "Gas used", gas_used.value());
+    write_counter(
+        os,
+        "monad_exec_sender_cache_hits",
+        "Transactions whose sender was found in the sender cache",
+        sender_cache_hits.value());
+    write_counter(
+        os,
+        "monad_exec_ingest_stall_microseconds",
+        "Time the executor waited on block ingest",
+        ingest_stall_us.value());
+    write_counter(
+        os,
+        "monad_exec_checkpoints_skipped",
+        "Checkpoints skipped because the previous one was still running",
+        checkpoints_skipped.value());
+    write_counter(
+        os,
+        "monad_exec_checkpoint_failures",
+        "Checkpoints that failed to be written",
+        checkpoint_failures.value());
+    write_counter(
+        os,
+        "monad_exec_checkpoint_pause_microseconds",
+        "Time the executor waited on a checkpoint to keep its version",
+        checkpoint_pause_us.value());
+    write_gauge(
+        os,
+        "monad_exec_block_number",
+        "Number of the last executed block",
+        block_number.value());
+    write_gauge(
+        os,
+        "monad_exec_ingest_queued",
+        "Block bodies queued for ingest",
+        ingest_queued.value());
+    write_gauge(
+        os,
+        "monad_exec_ingest_reading",
+        "Block bodies being read and decoded",
+        ingest_reading.value());
+    write_gauge(
+        os,
+        "monad_exec_ingest_recovering",
+        "Block bodies having their senders recovered",
+        ingest_recovering.value());
+    write_gauge(
+        os,
+        "monad_exec_ingest_ready",
+        "Ingested block bodies waiting for the executor",
+        ingest_ready.value());
+    write_gauge(
+        os,
+        "monad_exec_checkpoint_block_number",
+        "Number of the block of the last complete checkpoint",
+        checkpoint_block_number.value());
+    write_gauge(
+        os,
+        "monad_exec_resident_bytes",
+        "Resident set size of the process",
+        static_cast<int64_t>(monad_procfs_self_resident()));
+    std::map<std::string, double, std::less<>> stats;
+    {
+        std::lock_guard const lock{stats_mutex};
+        parse_stats(stats, "db", db_stats);
+        parse_stats(stats, "vm_block", vm_block_stats);
+        parse_stats(stats, "vm_compiler", vm_compiler_stats);
+    }
+    for (auto const &[name, value] : stats) {
+        os << fmt::format(
+            "# TYPE {0} gauge\n# HELP {0} Last value reported in the db or "
+            "VM stats\n{0} {1}\n",
+            name,
+            value);
+    }
+
+    // Full resolution buckets are too many to export. Power of two bounds
+    // line up with bucket boundaries, so these counts are exact, but since
+    // durations are whole microseconds each bucket holds the samples below
+    // its bound rather than at or below it
+    constexpr std::string_view name = "monad_exec_stage_duration_microseconds";
+    os << fmt::format(
+        "# TYPE {0} histogram\n# HELP {0} Time spent per block in each "
+        "stage\n",
+        name);
+    for (size_t s = 0; s < total.size(); ++s) {
+        HistogramSnapshot const &h = total[s];
+        for (unsigned bit = 0; bit < Histogram::MAX_VALUE_BITS; ++bit) {
+            uint64_t const le = uint64_t{1} << bit;
+            os << fmt::format(
+                "{}_bucket{{stage=\"{}\",le=\"{}\"}} {}\n",
+                name,
+                STAGE_NAMES[s],
+                le,
+                h.count_below(le));
+        }
+        os << fmt::format(
+            "{0}_bucket{{stage=\"{1}\",le=\"+Inf\"}} {2}\n"
+            "{0}_count{{stage=\"{1}\"}} {2}\n"
+            "{0}_sum{{stage=\"{1}\"}} {3}\n",
+            name,
+            STAGE_NAMES[s],
+            h.count,
+            h.sum);
+    }
+
+    constexpr std::string_view window_name =
+        "monad_exec_stage_window_duration_microseconds";
+    os << fmt::format(
+        "# TYPE {0} summary\n# HELP {0} Time spent per block in each stage, "
+        "over the sliding window\n",
+        window_name);
+    for (size_t s = 0; s < window.size(); ++s) {
+        HistogramSnapshot const &h = window[s];
+        for (double const q : QUANTILES) {
+            os << fmt::format(
+                "{}{{stage=\"{}\",quantile=\"{}\"}} {}\n",
+                window_name,
+                STAGE_NAMES[s],
+                q,
+                h.percentile(q));
+        }
+        os << fmt::format(
+            "{0}_count{{stage=\"{1}\"}} {2}\n"
+            "{0}_sum{{stage=\"{1}\"}} {3}\n",
+            window_name,
+            STAGE_NAMES[s],
+            h.count,
+            h.sum);
+    }
+    os << "# EOF\n";
+}
+
+ExecMetrics &exec_metrics()
+{
+    static ExecMetrics metrics;
+    return metrics;
+}
+
+MetricsExporter::MetricsExporter(
+    std::filesystem::path path, std::chrono::milliseconds const interval,
+    std::chrono::seconds const window)
+    : path_{std::move(path)}
+    , slice_{std::max(
+          std::chrono::duration_cast<std::chrono::milliseconds>(window) /
+              WINDOW_SLICES,
+          std::chrono::milliseconds{1})}
+    , interval_{path_.empty() ? slice_ : std::min(interval, slice_)}
+    , slice_begin_{std::chrono::steady_clock::now()}
+    , thread_{[this](std::stop_token const token) {
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        std::unique_lock lock{mutex};
+        while (!token.stop_requested()) {
+            cv.wait_for(lock, token, interval_, [] { return false; });
+            if (token.stop_requested()) {
+                break;
+            }
+            drain();
+            if (std::chrono::steady_clock::now() - slice_begin_ >= slice_) {
+                close_slice();
+            }
+            write_file();
+        }
+    }}
+{
+    if (!path_.empty()) {
+        exec_metrics().stats_wanted.store(true, std::memory_order_relaxed);
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    thread_.request_stop();
+    thread_.join();
+    drain();
+    close_slice();
+    if (slices_since_log_ != 0) {
+        log_window();
+    }
+    write_file();
+    exec_metrics().stats_wanted.store(false, std::memory_order_relaxed);
+    for (size_t s = 0; s < total_.size(); ++s) {
+        log_percentiles("total", STAGE_NAMES[s], total_[s]);
+    }
+}
+
+void MetricsExporter::drain()
+{
+    for (size_t s = 0; s < total_.size(); ++s) {
+        HistogramSnapshot const drained = exec_metrics().stages[s].drain();
+        total_[s] += drained;
+        current_slice_[s] += drained;
+    }
+}
+
+void MetricsExporter::close_slice()
+{
+    slices_[next_slice_] = current_slice_;
+    next_slice_ = (next_slice_ + 1) % WINDOW_SLICES;
+    current_slice_ = StageSnapshots{};
+    slice_begin_ = std::chrono::steady_clock::now();
+
+    window_ = StageSnapshots{};
+    for (StageSnapshots const &slice : slices_) {
+        for (size_t s = 0; s < window_.size(); ++s) {
+            window_[s] += slice[s];
+        }
+    }
+    if (++slices_since_log_ == WINDOW_SLICES) {
+        log_window();
+        slices_since_log_ = 0;
+    }
+}
+
+void MetricsExporter::log_window() const
+{
+    for (size_t s = 0; s < window_.size(); ++s) {
+        log_percentiles("window", STAGE_NAMES[s], window_[s]);
+    }
+}
+
+void MetricsExporter::write_file() const
+{
+    if (path_.empty()) {
+        return;
+    }
+    auto const tmp = std::filesystem::path{path_}.concat(".tmp");
+    {
+        std::ofstream os{tmp, std::ios::trunc};
+        exec_metrics().write_openmetrics(os, total_, window_);
+        if (!os) {
+            LOG_WARNING("Could not write metrics to {}", tmp.string());
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path_, ec);
+    if (ec) {
+        LOG_WARNING(
+            "Could not rename {} to {}: {}",
+            tmp.string(),
+            path_.string(),
+            ec.message());
+    }
+}
+
+MONAD_NAMESPACE_END
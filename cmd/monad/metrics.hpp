@@ -0,0 +1,249 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/config.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Monotonically increasing count
+class Counter
+{
+    std::atomic<uint64_t> value_{0};
+
+public:
+    void add(uint64_t const n)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+};
+
+/// Value that can go up and down; only the last one set is exported
+class Gauge
+{
+    std::atomic<int64_t> value_{0};
+
+public:
+    void set(int64_t const v)
+    {
+        value_.store(v, std::memory_order_relaxed);
+    }
+
+    int64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+};
+
+/// Point in time copy of a Histogram, summed over one or more drains
+struct HistogramSnapshot;
+
+/// Low overhead HDR-style distribution of durations in microseconds. Buckets
+/// are log-linear: values below 2^SUB_BUCKET_BITS get a bucket each, above
+/// that every power of two range is split into 2^SUB_BUCKET_BITS equal
+/// buckets, so any recorded value is known to within about 3%. Values of
+/// 2^MAX_VALUE_BITS and above are clamped.
+class Histogram
+{
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 5;
+    static constexpr unsigned MAX_VALUE_BITS = 36;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t NUM_BUCKETS =
+        SUB_BUCKETS * (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+
+public:
+    void record(std::chrono::microseconds);
+
+    /// Moves everything recorded so far into the returned snapshot
+    HistogramSnapshot drain();
+
+    static size_t bucket_index(uint64_t value);
+
+    /// Largest value that falls in bucket `i`
+    static uint64_t bucket_upper_bound(size_t i);
+};
+
+struct HistogramSnapshot
+{
+    std::array<uint64_t, Histogram::NUM_BUCKETS> buckets{};
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t max{0};
+
+    HistogramSnapshot &operator+=(HistogramSnapshot const &);
+
+    /// Smallest bucket upper bound at or below which a fraction `q` of the
+    /// samples fall, capped at the largest sample; 0 if there are none
+    uint64_t percentile(double q) const;
+
+    /// Number of samples smaller than `value`, which should be a power of two
+    /// so that it lines up with a bucket boundary
+    uint64_t count_below(uint64_t value) const;
+};
+
+/// Per-block stages timed by the runloops. Discovery is sampled once per scan
+/// of the ledger for new work, whether or not the scan found any.
+enum class BlockStage : uint8_t
+{
+    Discovery,
+    Read,
+    SenderRecovery,
+    Execution,
+    Commit,
+    Total,
+    Count
+};
+
+/// One executed block, as reported by a runloop
+struct BlockSample
+{
+    uint64_t block_number;
+    uint64_t transactions;
+    uint64_t retries;
+    uint64_t gas_used;
+    uint64_t sender_cache_hits;
+    std::chrono::microseconds sender_recovery_time;
+    std::chrono::microseconds tx_exec_time;
+    std::chrono::microseconds commit_time;
+    std::chrono::microseconds block_time;
+};
+
+using StageSnapshots =
+    std::array<HistogramSnapshot, static_cast<size_t>(BlockStage::Count)>;
+
+/// Process wide execution metrics. Recording is relaxed atomics, cheap enough
+/// for the executing thread, except for the db and VM stats strings, which
+/// are copied under a lock and only while an exporter writes a metrics file;
+/// draining, percentiles, stats parsing and all formatting happen in the
+/// exporter.
+struct ExecMetrics
+{
+    Counter blocks;
+    Counter transactions;
+    Counter retries;
+    Counter gas_used;
+    Counter sender_cache_hits;
+    Counter ingest_stall_us;
+    Counter checkpoints_skipped;
+    Counter checkpoint_failures;
+    Counter checkpoint_pause_us;
+    Gauge block_number;
+    Gauge ingest_queued;
+    Gauge ingest_reading;
+    Gauge ingest_recovering;
+    Gauge ingest_ready;
+    Gauge checkpoint_block_number;
+    std::array<Histogram, static_cast<size_t>(BlockStage::Count)> stages;
+
+    /// Latest db and VM stats strings, kept only while `stats_wanted`
+    std::atomic<bool> stats_wanted{false};
+    mutable std::mutex stats_mutex;
+    std::string db_stats;
+    std::string vm_block_stats;
+    std::string vm_compiler_stats;
+
+    Histogram &stage(BlockStage const s)
+    {
+        return stages[static_cast<size_t>(s)];
+    }
+
+    void record_block(BlockSample const &);
+
+    /// Keeps the db and VM stats strings the runloops log with each block;
+    /// their numeric `key=value` fields are exported as gauges, other fields
+    /// are ignored
+    void record_stats(
+        std::string_view db, std::string_view vm_block_counts,
+        std::string_view vm_compiler);
+
+    /// Writes every metric in the OpenMetrics text exposition format, with
+    /// stage histograms covering the whole run and stage percentiles covering
+    /// the sliding window
+    void write_openmetrics(
+        std::ostream &, StageSnapshots const &total,
+        StageSnapshots const &window) const;
+};
+
+/// The metrics every runloop records into
+ExecMetrics &exec_metrics();
+
+/// Drains the stage histograms on a timer. Window percentiles slide: the
+/// window is kept as a ring of WINDOW_SLICES sub-window snapshots, and every
+/// time a slice closes the oldest one is dropped and the rest are merged, so
+/// the exported percentiles always cover the last `window` to within one
+/// slice. Every `window` the p50/p99/p99.9/max of each stage are logged; if
+/// given a file, it is also rewritten every `interval` in the OpenMetrics
+/// text format, replacing it atomically. Percentiles over the whole run are
+/// logged, and the file written, one last time when the exporter is
+/// destroyed.
+class MetricsExporter
+{
+public:
+    static constexpr size_t WINDOW_SLICES = 6;
+
+private:
+    std::filesystem::path const path_;
+    std::chrono::milliseconds const slice_;
+    std::chrono::milliseconds const interval_;
+    StageSnapshots total_;
+    StageSnapshots current_slice_;
+    std::array<StageSnapshots, WINDOW_SLICES> slices_;
+    size_t next_slice_{0};
+    size_t slices_since_log_{0};
+    StageSnapshots window_;
+    std::chrono::steady_clock::time_point slice_begin_;
+    std::jthread thread_;
+
+    void drain();
+    void close_slice();
+    void log_window() const;
+    void write_file() const;
+
+public:
+    MetricsExporter(
+        std::filesystem::path, std::chrono::milliseconds interval,
+        std::chrono::seconds window);
+    ~MetricsExporter();
+
+    MetricsExporter(MetricsExporter const &) = delete;
+    MetricsExporter &operator=(MetricsExporter const &) = delete;
+};
+
+MONAD_NAMESPACE_END
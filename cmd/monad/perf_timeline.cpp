@@ -0,0 +1,158 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "perf_timeline.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/cleanup.h>
+#include <category/core/config.hpp>
+
+#include <quill/Quill.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <new>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+    #include <x86intrin.h>
+#endif
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+PerfTimelineHeader *g_perf_timeline = nullptr;
+PerfRecord *g_perf_records = nullptr;
+uint64_t g_perf_mask = 0;
+
+uint64_t read_tsc()
+{
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+}
+
+uint32_t thread_id()
+{
+    thread_local uint32_t const tid = static_cast<uint32_t>(gettid());
+    return tid;
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+static_assert(sizeof(PerfRecord) == 40);
+static_assert(alignof(PerfTimelineHeader) == 64);
+
+int init_perf_timeline(
+    std::filesystem::path const &path, uint8_t const capacity_shift)
+{
+    MONAD_ASSERT(
+        g_perf_timeline == nullptr, "perf timeline initialized twice?");
+    MONAD_ASSERT(capacity_shift < 32);
+
+    size_t const size =
+        sizeof(PerfTimelineHeader) + (sizeof(PerfRecord) << capacity_shift);
+    int fd [[gnu::cleanup(cleanup_close)]] =
+        open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        int const rc = errno;
+        LOG_ERROR("open of {} failed: {}", path.string(), strerror(rc));
+        return rc;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+        int const rc = errno;
+        LOG_ERROR("ftruncate of {} failed: {}", path.string(), strerror(rc));
+        return rc;
+    }
+    void *const map =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int const rc = errno;
+        LOG_ERROR("mmap of {} failed: {}", path.string(), strerror(rc));
+        return rc;
+    }
+
+    // The file is zero filled, so every record starts out unwritten
+    auto *const header = new (map) PerfTimelineHeader{};
+    header->capacity_shift = capacity_shift;
+    header->record_size = sizeof(PerfRecord);
+
+    // Calibrate the TSC against the steady clock
+    auto const steady_begin = std::chrono::steady_clock::now();
+    uint64_t const tsc_begin = read_tsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    uint64_t const tsc_end = read_tsc();
+    auto const elapsed_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - steady_begin)
+            .count();
+    header->tsc_per_second = static_cast<uint64_t>(
+        static_cast<double>(tsc_end - tsc_begin) * 1e9 /
+        static_cast<double>(elapsed_ns));
+    header->start_tsc = read_tsc();
+    header->start_epoch_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+    header->magic.store(PERF_TIMELINE_MAGIC, std::memory_order_release);
+
+    g_perf_records = reinterpret_cast<PerfRecord *>(header + 1);
+    g_perf_mask = (uint64_t{1} << capacity_shift) - 1;
+    g_perf_timeline = header;
+    LOG_INFO(
+        "Recording perf timeline to {} ({} records, {} TSC ticks/s)",
+        path.string(),
+        g_perf_mask + 1,
+        header->tsc_per_second);
+    return 0;
+}
+
+void record_perf_marker(
+    PerfStage const stage, PerfPhase const phase, uint64_t const block_number,
+    uint64_t const block_id_prefix)
+{
+    if (g_perf_timeline == nullptr) {
+        return;
+    }
+    uint64_t const i =
+        g_perf_timeline->next.fetch_add(1, std::memory_order_relaxed);
+    PerfRecord &record = g_perf_records[i & g_perf_mask];
+    record.seqno.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.tsc = read_tsc();
+    record.block_number = block_number;
+    record.block_id_prefix = block_id_prefix;
+    record.tid = thread_id();
+    record.stage = stage;
+    record.phase = phase;
+    record.seqno.store(i + 1, std::memory_order_release);
+}
+
+MONAD_NAMESPACE_END
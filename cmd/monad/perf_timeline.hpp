@@ -0,0 +1,139 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+/**
+ * @file
+ *
+ * Shared memory timeline of block processing stages. Every stage boundary is
+ * stored as a fixed size binary record stamped with the TSC, so an external
+ * reader can rebuild a per-block flame timeline without the daemon formatting
+ * anything. The execution event ring schema only carries the EVM enter/exit
+ * markers, which are still recorded there; this file covers the rest.
+ */
+
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+MONAD_NAMESPACE_BEGIN
+
+enum class PerfStage : uint8_t
+{
+    HeaderRead, ///< consensus header read, checksum and decode
+    BodyRead, ///< block body read and checksum (block db: also decompress)
+    Decode, ///< block body rlp decode
+    SenderRecovery, ///< sender and EIP-7702 authority recovery (fused)
+    Execution,
+    Commit, ///< state commit, including Merkle root calculation
+    HashBufferUpdate,
+    Finalization,
+};
+
+enum class PerfPhase : uint8_t
+{
+    Begin,
+    End,
+};
+
+// clang-format off
+
+/// One stage boundary. `seqno` is the record's position in the stream plus
+/// one, stored last with release ordering and zeroed while the record is
+/// being rewritten; a reader that sees the same non-zero `seqno` before and
+/// after copying the record got a consistent copy.
+struct PerfRecord
+{
+    std::atomic<uint64_t> seqno;
+    uint64_t tsc;
+    uint64_t block_number;    ///< 0 when not yet known, e.g. while reading
+    uint64_t block_id_prefix; ///< leading 8 bytes of the block id, or 0
+    uint32_t tid;             ///< kernel thread id of the recording thread
+    PerfStage stage;
+    PerfPhase phase;
+    uint16_t reserved;
+};
+
+constexpr uint64_t PERF_TIMELINE_MAGIC = 0x31656e696c656d74; // "tmeline1"
+
+/// Start of the timeline file, followed by 2^capacity_shift records used as
+/// a ring. `magic` is written last; readers must check it first.
+struct PerfTimelineHeader
+{
+    std::atomic<uint64_t> magic;
+    uint32_t capacity_shift;
+    uint32_t record_size;
+    uint64_t tsc_per_second;  ///< calibrated at startup
+    uint64_t start_tsc;       ///< TSC at startup ...
+    uint64_t start_epoch_ns;  ///< ... and the wall clock at the same moment
+    alignas(64) std::atomic<uint64_t> next; ///< number of records started
+};
+
+// clang-format on
+
+constexpr uint8_t DEFAULT_PERF_TIMELINE_CAPACITY_SHIFT = 20;
+
+/// Create the timeline file at `path` and start recording into it; returns 0
+/// or an errno value
+int init_perf_timeline(std::filesystem::path const &, uint8_t capacity_shift);
+
+/// Records a stage boundary; a no-op unless the timeline was initialized
+void record_perf_marker(
+    PerfStage, PerfPhase, uint64_t block_number, uint64_t block_id_prefix);
+
+inline uint64_t perf_id(bytes32_t const &block_id)
+{
+    uint64_t prefix = 0;
+    static_assert(sizeof(block_id.bytes) >= sizeof(prefix));
+    std::memcpy(&prefix, block_id.bytes, sizeof(prefix));
+    return prefix;
+}
+
+/// Records the begin marker of a stage on construction and its end marker on
+/// destruction
+class PerfScope
+{
+    PerfStage const stage_;
+    uint64_t const block_number_;
+    uint64_t const block_id_prefix_;
+
+public:
+    explicit PerfScope(
+        PerfStage const stage, uint64_t const block_number = 0,
+        uint64_t const block_id_prefix = 0)
+        : stage_{stage}
+        , block_number_{block_number}
+        , block_id_prefix_{block_id_prefix}
+    {
+        record_perf_marker(
+            stage_, PerfPhase::Begin, block_number_, block_id_prefix_);
+    }
+
+    ~PerfScope()
+    {
+        record_perf_marker(
+            stage_, PerfPhase::End, block_number_, block_id_prefix_);
+    }
+
+    PerfScope(PerfScope const &) = delete;
+    PerfScope &operator=(PerfScope const &) = delete;
+};
+
+MONAD_NAMESPACE_END
@@ -14,6 +14,12 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "runloop_ethereum.hpp"
+#include "block_prefetcher.hpp"
+#include "block_scratch.hpp"
+#include "checkpointer.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
+#include "sender_cache.hpp"
 
 #include <category/core/assert.h>
 #include <category/core/bytes.hpp>
@@ -42,7 +48,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 MONAD_ANONYMOUS_NAMESPACE_BEGIN
@@ -77,16 +87,30 @@ void log_tps(
 
 #pragma GCC diagnostic pop
 
-// Process a single historical Ethereum block
+// A historical block that has passed static validation and had its senders
+// recovered and tracers set up, ready to be executed. Heap allocated so the
+// tracers' references into it stay valid when it is handed between threads.
+struct PreparedBlock
+{
+    Block block;
+    std::chrono::system_clock::time_point block_start;
+    std::chrono::steady_clock::time_point block_begin;
+    std::vector<std::vector<std::optional<Address>>> recovered_authorities;
+    std::chrono::microseconds sender_recovery_time;
+    size_t sender_cache_hits;
+    BlockScratch scratch;
+};
+
+// Everything before execution that does not touch the database
 template <Traits traits>
-Result<void> process_ethereum_block(
-    Chain const &chain, Db &db, vm::VM &vm,
-    BlockHashBufferFinalized &block_hash_buffer,
-    fiber::PriorityPool &priority_pool, Block &block, bytes32_t const &block_id,
-    bytes32_t const &parent_block_id, bool const enable_tracing)
+Result<void> prepare_ethereum_block(
+    Chain const &chain, fiber::PriorityPool &priority_pool,
+    SenderCache &sender_cache, BlockScratchPool &scratch_pool,
+    PreparedBlock &prepared, bool const enable_tracing)
 {
-    [[maybe_unused]] auto const block_start = std::chrono::system_clock::now();
-    auto const block_begin = std::chrono::steady_clock::now();
+    Block const &block = prepared.block;
+    prepared.block_start = std::chrono::system_clock::now();
+    prepared.block_begin = std::chrono::steady_clock::now();
 
     // Block input validation
     BOOST_OUTCOME_TRY(chain.static_validate_header(block.header));
@@ -94,71 +118,112 @@ Result<void> process_ethereum_block(
 
     // Sender and authority recovery
     auto const sender_recovery_begin = std::chrono::steady_clock::now();
-    auto const recovered_senders =
-        recover_senders(block.transactions, priority_pool);
-    auto const recovered_authorities =
-        recover_authorities(block.transactions, priority_pool);
-    [[maybe_unused]] auto const sender_recovery_time =
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::Begin, block.header.number, 0);
+    RecoveredSenders recovered = recover_senders_and_authorities(
+        block.transactions, priority_pool, sender_cache);
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::End, block.header.number, 0);
+    prepared.sender_recovery_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - sender_recovery_begin);
-    std::vector<Address> senders(block.transactions.size());
-    for (unsigned i = 0; i < recovered_senders.size(); ++i) {
-        if (recovered_senders[i].has_value()) {
-            senders[i] = recovered_senders[i].value();
+    prepared.sender_cache_hits = recovered.cache_hits;
+    prepared.scratch =
+        scratch_pool.acquire(block.transactions, enable_tracing);
+    for (unsigned i = 0; i < recovered.senders.size(); ++i) {
+        if (recovered.senders[i].has_value()) {
+            prepared.scratch.senders[i] = recovered.senders[i].value();
         }
         else {
             return TransactionError::MissingSender;
         }
     }
+    prepared.recovered_authorities = std::move(recovered.authorities);
 
-    // Call tracer initialization
-    std::vector<std::vector<CallFrame>> call_frames{block.transactions.size()};
-    std::vector<std::unique_ptr<CallTracerBase>> call_tracers{
-        block.transactions.size()};
-    std::vector<std::unique_ptr<trace::StateTracer>> state_tracers{
-        block.transactions.size()};
-    for (unsigned i = 0; i < block.transactions.size(); ++i) {
-        call_tracers[i] =
-            enable_tracing
-                ? std::unique_ptr<CallTracerBase>{std::make_unique<CallTracer>(
-                      block.transactions[i], call_frames[i])}
-                : std::unique_ptr<CallTracerBase>{
-                      std::make_unique<NoopCallTracer>()};
-        state_tracers[i] = std::unique_ptr<trace::StateTracer>{
-            std::make_unique<trace::StateTracer>(std::monostate{})};
+    return outcome_e::success();
+}
+
+// Returns nullptr if the block db does not contain the block
+Result<std::unique_ptr<PreparedBlock>> prepare_block(
+    Chain const &chain, fiber::PriorityPool &priority_pool,
+    SenderCache &sender_cache, BlockScratchPool &scratch_pool,
+    std::optional<Block> block, bool const enable_tracing)
+{
+    if (!block.has_value()) {
+        return std::unique_ptr<PreparedBlock>{};
     }
+    auto prepared = std::make_unique<PreparedBlock>();
+    prepared->block = std::move(block.value());
+    evmc_revision const rev = chain.get_revision(
+        prepared->block.header.number, prepared->block.header.timestamp);
+    BOOST_OUTCOME_TRY([&] {
+        SWITCH_EVM_TRAITS(
+            prepare_ethereum_block,
+            chain,
+            priority_pool,
+            sender_cache,
+            scratch_pool,
+            *prepared,
+            enable_tracing);
+        MONAD_ABORT_PRINTF("unhandled rev switch case: %d", rev);
+    }());
+    return prepared;
+}
+
+// Execute and commit a single prepared historical Ethereum block.
+// `on_executed` runs once the transactions have executed and the execution
+// stage has ended, just before the commit, so the caller can overlap work
+// with it.
+template <Traits traits>
+Result<void> process_ethereum_block(
+    Chain const &chain, Db &db, vm::VM &vm,
+    BlockHashBufferFinalized &block_hash_buffer,
+    fiber::PriorityPool &priority_pool, PreparedBlock &prepared,
+    bytes32_t const &block_id, bytes32_t const &parent_block_id,
+    std::function<void()> const &on_executed)
+{
+    Block &block = prepared.block;
 
     // Core execution: transaction-level EVM execution that tracks state
     // changes but does not commit them
     db.set_block_and_prefix(block.header.number - 1, parent_block_id);
     BlockMetrics block_metrics;
     BlockState block_state(db, vm);
+    record_perf_marker(
+        PerfStage::Execution, PerfPhase::Begin, block.header.number, 0);
     BOOST_OUTCOME_TRY(
         auto const receipts,
         execute_block<traits>(
             chain,
             block,
-            senders,
-            recovered_authorities,
+            prepared.scratch.senders,
+            prepared.recovered_authorities,
             block_state,
             block_hash_buffer,
             priority_pool.fiber_group(),
             block_metrics,
-            call_tracers,
-            state_tracers));
+            prepared.scratch.call_tracers,
+            prepared.scratch.state_tracers));
+    record_perf_marker(
+        PerfStage::Execution, PerfPhase::End, block.header.number, 0);
+    on_executed();
 
     // Database commit of state changes (incl. Merkle root calculations)
     block_state.log_debug();
     auto const commit_begin = std::chrono::steady_clock::now();
+    record_perf_marker(
+        PerfStage::Commit, PerfPhase::Begin, block.header.number, 0);
     block_state.commit(
         bytes32_t{block.header.number},
         block.header,
         receipts,
-        call_frames,
-        senders,
+        prepared.scratch.call_frames,
+        prepared.scratch.senders,
         block.transactions,
         block.ommers,
         block.withdrawals);
+    record_perf_marker(
+        PerfStage::Commit, PerfPhase::End, block.header.number, 0);
     [[maybe_unused]] auto const commit_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - commit_begin);
@@ -174,30 +239,52 @@ Result<void> process_ethereum_block(
 
     // Commit prologue: database finalization, computation of the Ethereum
     // block hash to append to the circular hash buffer
-    db.finalize(block.header.number, block_id);
-    db.update_verified_block(block.header.number);
-    auto const eth_block_hash =
-        to_bytes(keccak256(rlp::encode_block_header(output_header)));
-    block_hash_buffer.set(block.header.number, eth_block_hash);
+    {
+        PerfScope const perf{PerfStage::Finalization, block.header.number};
+        db.finalize(block.header.number, block_id);
+        db.update_verified_block(block.header.number);
+    }
+    {
+        PerfScope const perf{PerfStage::HashBufferUpdate, block.header.number};
+        auto const eth_block_hash =
+            to_bytes(keccak256(rlp::encode_block_header(output_header)));
+        block_hash_buffer.set(block.header.number, eth_block_hash);
+    }
 
-    // Emit the block metrics log line
+    // Record the block metrics and emit the log line
     [[maybe_unused]] auto const block_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::steady_clock::now() - block_begin);
+            std::chrono::steady_clock::now() - prepared.block_begin);
+    exec_metrics().record_block(BlockSample{
+        .block_number = block.header.number,
+        .transactions = block.transactions.size(),
+        .retries = block_metrics.num_retries(),
+        .gas_used = output_header.gas_used,
+        .sender_cache_hits = prepared.sender_cache_hits,
+        .sender_recovery_time = prepared.sender_recovery_time,
+        .tx_exec_time = block_metrics.tx_exec_time(),
+        .commit_time = commit_time,
+        .block_time = block_time});
+
+    auto const db_stats = db.print_stats();
+    auto const vm_block_counts = vm.print_and_reset_block_counts();
+    auto const vm_compiler_stats = vm.print_compiler_stats();
+    exec_metrics().record_stats(db_stats, vm_block_counts, vm_compiler_stats);
+
     LOG_INFO(
         "__exec_block,bl={:8},ts={}"
         ",tx={:5},rt={:4},rtp={:5.2f}%"
         ",sr={:>7},txe={:>8},cmt={:>8},tot={:>8},tpse={:5},tps={:5}"
-        ",gas={:9},gpse={:4},gps={:3}{}{}{}",
+        ",gas={:9},gpse={:4},gps={:3},sch={:5}{}{}{}",
         block.header.number,
         std::chrono::duration_cast<std::chrono::milliseconds>(
-            block_start.time_since_epoch())
+            prepared.block_start.time_since_epoch())
             .count(),
         block.transactions.size(),
         block_metrics.num_retries(),
         100.0 * (double)block_metrics.num_retries() /
             std::max(1.0, (double)block.transactions.size()),
-        sender_recovery_time,
+        prepared.sender_recovery_time,
         block_metrics.tx_exec_time(),
         commit_time,
         block_time,
@@ -209,9 +296,10 @@ Result<void> process_ethereum_block(
         output_header.gas_used /
             (uint64_t)std::max(1L, block_metrics.tx_exec_time().count()),
         output_header.gas_used / (uint64_t)std::max(1L, block_time.count()),
-        db.print_stats(),
-        vm.print_and_reset_block_counts(),
-        vm.print_compiler_stats());
+        prepared.sender_cache_hits,
+        db_stats,
+        vm_block_counts,
+        vm_compiler_stats);
 
     return outcome_e::success();
 }
@@ -223,9 +311,11 @@ MONAD_NAMESPACE_BEGIN
 Result<std::pair<uint64_t, uint64_t>> runloop_ethereum(
     Chain const &chain, std::filesystem::path const &ledger_dir, Db &db,
     vm::VM &vm, BlockHashBufferFinalized &block_hash_buffer,
-    fiber::PriorityPool &priority_pool, uint64_t &block_num,
-    uint64_t const end_block_num, sig_atomic_t const volatile &stop,
-    bool const enable_tracing)
+    fiber::PriorityPool &priority_pool, SenderCache &sender_cache,
+    uint64_t &block_num, uint64_t const end_block_num,
+    sig_atomic_t const volatile &stop, bool const enable_tracing,
+    size_t const prefetch_blocks, bool const overlap_prepare,
+    Checkpointer *const checkpointer)
 {
     uint64_t const batch_size =
         end_block_num == std::numeric_limits<uint64_t>::max() ? 1 : 1000;
@@ -237,13 +327,47 @@ Result<std::pair<uint64_t, uint64_t>> runloop_ethereum(
     uint64_t ntxs = 0;
 
     BlockDb block_db(ledger_dir);
+    BlockPrefetcher prefetcher{
+        block_db, block_num, end_block_num, prefetch_blocks};
+    BlockScratchPool scratch_pool;
     bytes32_t parent_block_id{};
+    // With overlap_prepare, the next block is prepared on another thread
+    // while the current one commits. Only preparation overlaps: the commit
+    // and its state root check still complete before the next block
+    // executes. Preparation errors surface on the next iteration, after the
+    // current block is finalized, same as without.
+    std::future<Result<std::unique_ptr<PreparedBlock>>> next_prepared;
     while (block_num <= end_block_num && stop == 0) {
-        Block block;
+        BOOST_OUTCOME_TRY(
+            auto const prepared,
+            next_prepared.valid() ? next_prepared.get()
+                                  : prepare_block(
+                                        chain,
+                                        priority_pool,
+                                        sender_cache,
+                                        scratch_pool,
+                                        prefetcher.pop(),
+                                        enable_tracing));
         MONAD_ASSERT_PRINTF(
-            block_db.get(block_num, block),
-            "Could not query %lu from blockdb",
-            block_num);
+            prepared != nullptr, "Could not query %lu from blockdb", block_num);
+        Block const &block = prepared->block;
+
+        auto const on_executed = [&] {
+            if (!overlap_prepare || block_num >= end_block_num || stop != 0) {
+                return;
+            }
+            next_prepared = std::async(
+                std::launch::async,
+                [&, next_block = prefetcher.pop()] mutable {
+                    return prepare_block(
+                        chain,
+                        priority_pool,
+                        sender_cache,
+                        scratch_pool,
+                        std::move(next_block),
+                        enable_tracing);
+                });
+        };
 
         bytes32_t const block_id = bytes32_t{block.header.number};
         evmc_revision const rev =
@@ -257,12 +381,16 @@ Result<std::pair<uint64_t, uint64_t>> runloop_ethereum(
                 vm,
                 block_hash_buffer,
                 priority_pool,
-                block,
+                *prepared,
                 block_id,
                 parent_block_id,
-                enable_tracing);
+                on_executed);
             MONAD_ABORT_PRINTF("unhandled rev switch case: %d", rev);
         }());
+        scratch_pool.release(std::move(prepared->scratch));
+        if (checkpointer != nullptr) {
+            checkpointer->on_finalized(block_num);
+        }
 
         ntxs += block.transactions.size();
         batch_num_txs += block.transactions.size();
@@ -289,6 +417,12 @@ Result<std::pair<uint64_t, uint64_t>> runloop_ethereum(
         log_tps(
             block_num, batch_num_blocks, batch_num_txs, batch_gas, batch_begin);
     }
+    LOG_INFO(
+        "Block db reads took {} in total, executor stalled on them for {} "
+        "(prefetch depth {})",
+        prefetcher.read_time(),
+        prefetcher.stall_time(),
+        prefetch_blocks);
     return {ntxs, total_gas};
 }
 
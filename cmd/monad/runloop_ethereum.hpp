@@ -19,6 +19,7 @@
 #include <category/core/result.hpp>
 #include <category/vm/vm.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <utility>
@@ -30,6 +31,8 @@ MONAD_NAMESPACE_BEGIN
 struct Chain;
 struct Db;
 class BlockHashBufferFinalized;
+class Checkpointer;
+class SenderCache;
 
 namespace fiber
 {
@@ -38,7 +41,8 @@ namespace fiber
 
 Result<std::pair<uint64_t, uint64_t>> runloop_ethereum(
     Chain const &, std::filesystem::path const &, Db &, vm::VM &,
-    BlockHashBufferFinalized &, fiber::PriorityPool &, uint64_t &, uint64_t,
-    sig_atomic_t const volatile &, bool enable_tracing);
+    BlockHashBufferFinalized &, fiber::PriorityPool &, SenderCache &,
+    uint64_t &, uint64_t, sig_atomic_t const volatile &, bool enable_tracing,
+    size_t prefetch_blocks, bool overlap_prepare, Checkpointer *);
 
 MONAD_NAMESPACE_END
@@ -14,7 +14,15 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "runloop_monad.hpp"
+#include "block_scratch.hpp"
 #include "file_io.hpp"
+#include "ingest_pipeline.hpp"
+#include "ledger_watcher.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
+#include "sender_cache.hpp"
+#include "senders_checkpoint.hpp"
+#include "wal_reader.hpp"
 
 #include <category/core/assert.h>
 #include <category/core/blake3.hpp>
@@ -51,14 +59,18 @@
 
 #include <ankerl/unordered_dense.h>
 #include <boost/outcome/try.hpp>
+#include <evmc/evmc.h>
+#include <evmc/hex.hpp>
 #include <quill/Quill.h>
 #include <quill/detail/LogMacros.h>
 
+#include <algorithm>
+#include <bit>
 #include <chrono>
 #include <deque>
 #include <filesystem>
 #include <optional>
-#include <thread>
+#include <system_error>
 #include <variant>
 #include <vector>
 
@@ -74,6 +86,34 @@ struct BlockCacheEntry
 using BlockCache =
     ankerl::unordered_dense::segmented_map<bytes32_t, BlockCacheEntry>;
 
+/// Persists the sets of the last finalized block and its parent, which are
+/// all a restart needs to validate the blocks proposed on top of it
+void save_finalized_senders(
+    std::filesystem::path const &path, uint256_t const &chain_id,
+    BlockCache const &block_cache, bytes32_t const &finalized_id)
+{
+    std::vector<SendersCheckpointEntry> entries;
+    bytes32_t id = finalized_id;
+    while (entries.size() < 2) {
+        auto const it = block_cache.find(id);
+        if (it == block_cache.end()) {
+            break;
+        }
+        BlockCacheEntry const &entry = it->second;
+        entries.emplace_back(SendersCheckpointEntry{
+            .block_number = entry.block_number,
+            .block_id = id,
+            .parent_id = entry.parent_id,
+            .senders_and_authorities = entry.senders_and_authorities});
+        id = entry.parent_id;
+    }
+    save_senders_checkpoint(path, chain_id, entries);
+}
+
+// Decoded, checksum-verified consensus headers keyed by block id
+using HeaderCache =
+    ankerl::unordered_dense::segmented_map<bytes32_t, ConsensusHeader>;
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -172,8 +212,11 @@ Result<BlockExecOutput> propose_block(
     bytes32_t const &block_id,
     MonadConsensusBlockHeader const &consensus_header, Block block,
     BlockHashChain &block_hash_chain, MonadChain const &chain, Db &db,
-    vm::VM &vm, fiber::PriorityPool &priority_pool, bool const is_first_block,
-    bool const enable_tracing, BlockCache &block_cache)
+    vm::VM &vm, fiber::PriorityPool &priority_pool,
+    BlockScratchPool &scratch_pool, bool const is_first_block,
+    bool const enable_tracing, BlockCache &block_cache,
+    RecoveredSenders &recovered,
+    std::chrono::microseconds const sender_recovery_time)
 {
     [[maybe_unused]] auto const block_start = std::chrono::system_clock::now();
     auto const block_begin = std::chrono::steady_clock::now();
@@ -185,65 +228,34 @@ Result<BlockExecOutput> propose_block(
     BOOST_OUTCOME_TRY(chain.static_validate_header(block.header));
     BOOST_OUTCOME_TRY(static_validate_block<traits>(block));
 
-    // Sender and EIP-7702 authorities recovery
-    auto const sender_recovery_begin = std::chrono::steady_clock::now();
-    auto const recovered_senders =
-        recover_senders(block.transactions, priority_pool);
-    auto const recovered_authorities =
-        recover_authorities(block.transactions, priority_pool);
-    [[maybe_unused]] auto const sender_recovery_time =
-        std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::steady_clock::now() - sender_recovery_begin);
-    std::vector<Address> senders(block.transactions.size());
-    for (unsigned i = 0; i < recovered_senders.size(); ++i) {
-        if (recovered_senders[i].has_value()) {
-            senders[i] = recovered_senders[i].value();
+    // Sender and EIP-7702 authorities were recovered by the ingest pipeline
+    MONAD_ASSERT(recovered.senders.size() == block.transactions.size());
+    MONAD_ASSERT(recovered.authorities.size() == block.transactions.size());
+    auto const &recovered_authorities = recovered.authorities;
+    // Senders, tracers and call frame vectors, recycled across blocks
+    BlockScratch scratch =
+        scratch_pool.acquire(block.transactions, enable_tracing);
+    std::vector<Address> &senders = scratch.senders;
+    for (unsigned i = 0; i < recovered.senders.size(); ++i) {
+        if (recovered.senders[i].has_value()) {
+            senders[i] = recovered.senders[i].value();
         }
         else {
             return TransactionError::MissingSender;
         }
     }
-    ankerl::unordered_dense::segmented_set<Address> senders_and_authorities;
-    for (Address const &sender : senders) {
-        senders_and_authorities.insert(sender);
-    }
-    for (std::vector<std::optional<Address>> const &authorities :
-         recovered_authorities) {
-        for (std::optional<Address> const &authority : authorities) {
-            if (authority.has_value()) {
-                senders_and_authorities.insert(authority.value());
-            }
-        }
-    }
     MONAD_ASSERT(block_cache
                      .emplace(
                          block_id,
                          BlockCacheEntry{
                              .block_number = block.header.number,
                              .parent_id = consensus_header.parent_id(),
-                             .senders_and_authorities =
-                                 std::move(senders_and_authorities)})
+                             .senders_and_authorities = std::move(
+                                 recovered.senders_and_authorities)})
                      .second);
     BOOST_OUTCOME_TRY(
         static_validate_monad_body<traits>(senders, block.transactions));
 
-    // Create call frames vectors for tracers
-    std::vector<std::vector<CallFrame>> call_frames{block.transactions.size()};
-    std::vector<std::unique_ptr<CallTracerBase>> call_tracers{
-        block.transactions.size()};
-    std::vector<std::unique_ptr<trace::StateTracer>> state_tracers{
-        block.transactions.size()};
-    for (unsigned i = 0; i < block.transactions.size(); ++i) {
-        call_tracers[i] =
-            enable_tracing
-                ? std::unique_ptr<CallTracerBase>{std::make_unique<CallTracer>(
-                      block.transactions[i], call_frames[i])}
-                : std::unique_ptr<CallTracerBase>{
-                      std::make_unique<NoopCallTracer>()};
-        state_tracers[i] = std::unique_ptr<trace::StateTracer>{
-            std::make_unique<trace::StateTracer>(std::monostate{})};
-    }
-
     MonadChainContext chain_context{
         .grandparent_senders_and_authorities = nullptr,
         .parent_senders_and_authorities = nullptr,
@@ -280,6 +292,11 @@ Result<BlockExecOutput> propose_block(
     BlockMetrics block_metrics;
     BlockState block_state(db, vm);
     record_block_marker_event(MONAD_EXEC_BLOCK_PERF_EVM_ENTER);
+    record_perf_marker(
+        PerfStage::Execution,
+        PerfPhase::Begin,
+        block.header.number,
+        perf_id(block_id));
     BOOST_OUTCOME_TRY(
         auto const results,
         execute_block<traits>(
@@ -291,8 +308,8 @@ Result<BlockExecOutput> propose_block(
             block_hash_buffer,
             priority_pool.fiber_group(),
             block_metrics,
-            call_tracers,
-            state_tracers,
+            scratch.call_tracers,
+            scratch.state_tracers,
             [&chain, &block, &chain_context](
                 Address const &sender,
                 Transaction const &tx,
@@ -309,19 +326,35 @@ Result<BlockExecOutput> propose_block(
                     chain_context);
             }));
     record_block_marker_event(MONAD_EXEC_BLOCK_PERF_EVM_EXIT);
+    record_perf_marker(
+        PerfStage::Execution,
+        PerfPhase::End,
+        block.header.number,
+        perf_id(block_id));
 
     // Database commit of state changes (incl. Merkle root calculations)
     block_state.log_debug();
     auto const commit_begin = std::chrono::steady_clock::now();
+    record_perf_marker(
+        PerfStage::Commit,
+        PerfPhase::Begin,
+        block.header.number,
+        perf_id(block_id));
     block_state.commit(
         block_id,
         block.header,
         results,
-        call_frames,
+        scratch.call_frames,
         senders,
         block.transactions,
         block.ommers,
         block.withdrawals);
+    record_perf_marker(
+        PerfStage::Commit,
+        PerfPhase::End,
+        block.header.number,
+        perf_id(block_id));
+    scratch_pool.release(std::move(scratch));
     [[maybe_unused]] auto const commit_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - commit_begin);
@@ -339,23 +372,45 @@ Result<BlockExecOutput> propose_block(
 
     // Commit prologue: computation of the Ethereum block hash to append to
     // the circular hash buffer
-    exec_output.eth_block_hash =
-        to_bytes(keccak256(rlp::encode_block_header(exec_output.eth_header)));
-    block_hash_chain.propose(
-        exec_output.eth_block_hash,
-        block.header.number,
-        block_id,
-        consensus_header.parent_id());
+    {
+        PerfScope const perf{
+            PerfStage::HashBufferUpdate,
+            block.header.number,
+            perf_id(block_id)};
+        exec_output.eth_block_hash = to_bytes(
+            keccak256(rlp::encode_block_header(exec_output.eth_header)));
+        block_hash_chain.propose(
+            exec_output.eth_block_hash,
+            block.header.number,
+            block_id,
+            consensus_header.parent_id());
+    }
 
-    // Emit the block metrics log line
+    // Record the block metrics and emit the log line
     [[maybe_unused]] auto const block_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - block_begin);
+    exec_metrics().record_block(BlockSample{
+        .block_number = block.header.number,
+        .transactions = block.transactions.size(),
+        .retries = block_metrics.num_retries(),
+        .gas_used = exec_output.eth_header.gas_used,
+        .sender_cache_hits = recovered.cache_hits,
+        .sender_recovery_time = sender_recovery_time,
+        .tx_exec_time = block_metrics.tx_exec_time(),
+        .commit_time = commit_time,
+        .block_time = block_time});
+
+    auto const db_stats = db.print_stats();
+    auto const vm_block_counts = vm.print_and_reset_block_counts();
+    auto const vm_compiler_stats = vm.print_compiler_stats();
+    exec_metrics().record_stats(db_stats, vm_block_counts, vm_compiler_stats);
+
     LOG_INFO(
         "__exec_block,bl={:8},id={},ts={}"
         ",tx={:5},rt={:4},rtp={:5.2f}%"
         ",sr={:>7},txe={:>8},cmt={:>8},tot={:>8},tpse={:5},tps={:5}"
-        ",gas={:9},gpse={:4},gps={:3}{}{}{}",
+        ",gas={:9},gpse={:4},gps={:3},sch={:5}{}{}{}",
         block.header.number,
         block_id,
         std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -378,39 +433,42 @@ Result<BlockExecOutput> propose_block(
             (uint64_t)std::max(1L, block_metrics.tx_exec_time().count()),
         exec_output.eth_header.gas_used /
             (uint64_t)std::max(1L, block_time.count()),
-        db.print_stats(),
-        vm.print_and_reset_block_counts(),
-        vm.print_compiler_stats());
+        recovered.cache_hits,
+        db_stats,
+        vm_block_counts,
+        vm_compiler_stats);
 
     return exec_output;
 }
 
-template <class MonadConsensusBlockHeader, class Fn>
-std::optional<bytes32_t> handle_header(
-    bytes32_t const &id, byte_string_view data, uint64_t const start_exclusive,
-    uint64_t const end_inclusive, Fn const &fn)
+// Returns the decoded header for `id`, reading and checksumming the header
+// file only if it is not already cached. Header files are named by their
+// checksum, so a cached entry can never go stale.
+ConsensusHeader const &load_header(
+    HeaderCache &header_cache, bytes32_t const &id,
+    std::filesystem::path const &header_dir, MonadChain const &chain)
 {
-    auto const header_res =
-        rlp::decode_consensus_block_header<MonadConsensusBlockHeader>(data);
-    MONAD_ASSERT_PRINTF(
-        !header_res.has_error(),
-        "Could not rlp decode header: %s",
-        evmc::hex(id).c_str());
-    auto const &header = header_res.value();
-    if (header.seqno > start_exclusive && header.seqno <= end_inclusive) {
-        fn(id, header);
+    if (auto const it = header_cache.find(id); it != header_cache.end()) {
+        return it->second;
     }
-    if (header.seqno <= (start_exclusive + 1)) {
-        return std::nullopt;
-    }
-    return header.parent_id();
+
+    // Only the runloop thread walks headers; the buffer is reused across reads
+    // and nothing decoded from it outlives this call
+    thread_local byte_string buf;
+    PerfScope const perf{PerfStage::HeaderRead, 0, perf_id(id)};
+    return header_cache.emplace(id, read_header(id, header_dir, chain, buf))
+        .first->second;
 }
 
+// Walks the header chain from `head` through parent pointers, calling `fn` on
+// every header with a seqno in (start_exclusive, end_inclusive]. Only headers
+// not yet in `header_cache` touch the disk, so once the walk reaches a header
+// seen on a previous iteration the remainder of it runs from memory.
 template <class Fn>
 bytes32_t for_each_header(
     std::filesystem::path const &head, std::filesystem::path const &header_dir,
-    MonadChain const &chain, uint64_t const start_exclusive,
-    uint64_t const end_inclusive, Fn const &fn)
+    MonadChain const &chain, HeaderCache &header_cache,
+    uint64_t const start_exclusive, uint64_t const end_inclusive, Fn const &fn)
 {
     bytes32_t const head_id = head_pointer_to_id(head);
     if (MONAD_UNLIKELY(head_id == bytes32_t{})) {
@@ -418,44 +476,22 @@ bytes32_t for_each_header(
     }
     bytes32_t id = head_id;
     while (true) {
-        auto const data = read_file(id, header_dir);
-        byte_string_view view{data};
-        auto const ts = rlp::decode_consensus_block_header_timestamp_s(view);
-        MONAD_ASSERT_PRINTF(
-            !ts.has_error(),
-            "Could not rlp decode timestamp from header: %s",
-            evmc::hex(id).c_str());
-        auto const rev = chain.get_monad_revision(ts.value());
-
-        auto const body = [&]<Traits traits> {
-            std::optional<bytes32_t> next_id;
-            if constexpr (traits::monad_rev() >= MONAD_FOUR) {
-                next_id = handle_header<MonadConsensusBlockHeaderV2>(
-                    id, data, start_exclusive, end_inclusive, fn);
-            }
-            else if constexpr (traits::monad_rev() >= MONAD_THREE) {
-                next_id = handle_header<MonadConsensusBlockHeaderV1>(
-                    id, data, start_exclusive, end_inclusive, fn);
-            }
-            else {
-                next_id = handle_header<MonadConsensusBlockHeaderV0>(
-                    id, data, start_exclusive, end_inclusive, fn);
-            }
-            if (!next_id.has_value()) {
-                return false;
-            }
-            id = next_id.value();
-            return true;
-        };
-
-        auto const keep_going = [&] {
-            SWITCH_MONAD_TRAITS(body.template operator());
-            MONAD_ASSERT(false);
-        }();
-
-        if (!keep_going) {
+        std::optional<bytes32_t> const next_id = std::visit(
+            [&](auto const &header) -> std::optional<bytes32_t> {
+                if (header.seqno > start_exclusive &&
+                    header.seqno <= end_inclusive) {
+                    fn(id, header);
+                }
+                if (header.seqno <= (start_exclusive + 1)) {
+                    return std::nullopt;
+                }
+                return header.parent_id();
+            },
+            load_header(header_cache, id, header_dir, chain));
+        if (!next_id.has_value()) {
             break;
         }
+        id = next_id.value();
     }
     return head_id;
 }
@@ -468,11 +504,24 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
     MonadChain const &chain, std::filesystem::path const &ledger_dir,
     mpt::Db &raw_db, Db &db, vm::VM &vm,
     BlockHashBufferFinalized &block_hash_buffer,
-    fiber::PriorityPool &priority_pool, uint64_t &finalized_block_num,
-    uint64_t const end_block_num, sig_atomic_t const volatile &stop,
-    bool const enable_tracing)
+    fiber::PriorityPool &priority_pool, SenderCache &sender_cache,
+    uint64_t &finalized_block_num, uint64_t const end_block_num,
+    sig_atomic_t const volatile &stop, bool const enable_tracing,
+    std::filesystem::path const &senders_checkpoint,
+    std::filesystem::path const &wal_position)
 {
-    constexpr auto SLEEP_TIME = std::chrono::microseconds(100);
+    // Upper bound on how long the runloop sleeps without a ledger change
+    // notification before re-scanning the ledger anyway
+    constexpr auto FALLBACK_POLL_INTERVAL = std::chrono::milliseconds(10);
+    // Number of blocks ingested ahead of the one being executed
+    constexpr size_t INGEST_PIPELINE_DEPTH = 4;
+    // Most WAL entries taken per iteration when tailing the WAL
+    constexpr size_t WAL_BATCH_SIZE = 256;
+    // Minimum time between rewrites of the senders checkpoint. A restart can
+    // only use a checkpoint of the last finalized block, but a stale one
+    // merely costs recovering those senders again, and a clean exit always
+    // writes it
+    constexpr auto SENDERS_CHECKPOINT_INTERVAL = std::chrono::seconds(5);
     uint64_t const start_block_num = finalized_block_num;
     uint256_t const chain_id = chain.get_chain_id();
     BlockHashChain block_hash_chain(block_hash_buffer);
@@ -487,46 +536,63 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
 
     MONAD_ASSERT(last_finalized_block_number != mpt::INVALID_BLOCK_NUM);
 
+    LedgerWatcher ledger_watcher{
+        header_dir,
+        FALLBACK_POLL_INTERVAL,
+        wal_position.empty() ? std::filesystem::path{} : ledger_dir / "wal"};
+    bool woken = false;
+
+    HeaderCache header_cache;
     BlockCache block_cache;
+    uint64_t const cache_floor =
+        last_finalized_block_number > 2 ? last_finalized_block_number - 2 : 0;
+    if (!senders_checkpoint.empty()) {
+        for (auto &entry :
+             load_senders_checkpoint(senders_checkpoint, chain_id)) {
+            if (entry.block_number > cache_floor &&
+                entry.block_number <= last_finalized_block_number) {
+                block_cache.emplace(
+                    entry.block_id,
+                    BlockCacheEntry{
+                        .block_number = entry.block_number,
+                        .parent_id = entry.parent_id,
+                        .senders_and_authorities =
+                            std::move(entry.senders_and_authorities)});
+            }
+        }
+        LOG_INFO(
+            "Restored senders of {} blocks from {}",
+            block_cache.size(),
+            senders_checkpoint);
+    }
     for_each_header(
         finalized_head,
         header_dir,
         chain,
-        last_finalized_block_number > 2 ? last_finalized_block_number - 2 : 0,
+        header_cache,
+        cache_floor,
         last_finalized_block_number,
-        [&block_cache, &priority_pool, body_dir](
+        [&block_cache, &priority_pool, &sender_cache, body_dir](
             bytes32_t const &id, auto const &header) {
+            if (block_cache.contains(id)) {
+                return;
+            }
             MonadConsensusBlockBody const body =
                 read_body(header.block_body_id, body_dir);
-            std::vector<std::optional<Address>> const recovered =
-                recover_senders(body.transactions, priority_pool);
-            std::vector<Address> senders;
-            senders.reserve(recovered.size());
-            for (std::optional<Address> const &addr : recovered) {
-                MONAD_ASSERT(addr.has_value());
-                senders.emplace_back(addr.value());
-            }
-            ankerl::unordered_dense::segmented_set<Address>
-                senders_and_authorities;
-            for (Address const &sender : senders) {
-                senders_and_authorities.insert(sender);
-            }
-            for (std::vector<std::optional<Address>> const &authorities :
-                 recover_authorities(body.transactions, priority_pool)) {
-                for (std::optional<Address> const &authority : authorities) {
-                    if (authority.has_value()) {
-                        senders_and_authorities.insert(authority.value());
-                    }
-                }
-            }
+            RecoveredSenders recovered = recover_senders_and_authorities(
+                body.transactions, priority_pool, sender_cache);
+            MONAD_ASSERT(std::ranges::all_of(
+                recovered.senders, [](std::optional<Address> const &sender) {
+                    return sender.has_value();
+                }));
             MONAD_ASSERT(block_cache
                              .emplace(
                                  id,
                                  BlockCacheEntry{
                                      .block_number = header.seqno,
                                      .parent_id = header.parent_id(),
-                                     .senders_and_authorities =
-                                         std::move(senders_and_authorities)})
+                                     .senders_and_authorities = std::move(
+                                         recovered.senders_and_authorities)})
                              .second);
         });
 
@@ -536,10 +602,7 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
     struct ToExecute
     {
         bytes32_t block_id;
-        std::variant<
-            MonadConsensusBlockHeaderV0, MonadConsensusBlockHeaderV1,
-            MonadConsensusBlockHeaderV2>
-            header;
+        ConsensusHeader header;
     };
 
     struct ToFinalize
@@ -551,6 +614,65 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
 
     std::deque<ToExecute> to_execute;
     std::deque<ToFinalize> to_finalize;
+    IngestPipeline ingest_pipeline{
+        body_dir, priority_pool, sender_cache, INGEST_PIPELINE_DEPTH};
+    BlockScratchPool scratch_pool;
+    std::optional<bytes32_t> unsaved_finalized_id;
+    std::chrono::steady_clock::time_point senders_checkpoint_saved{};
+
+    // With a WAL position file, blocks are discovered by tailing the
+    // consensus WAL from the recorded position, each exactly once, instead
+    // of walking the header chain from the heads on every iteration
+    std::optional<WalReader> wal_reader;
+    std::optional<WalEntry> last_wal_entry;
+    // Entries past the recorded position may have been handled before a
+    // crash, so the first batch still asks the db what has been executed
+    bool probe_executed = true;
+    // Last block finalized by the WAL so far, for the canonical chain check
+    // of proposals. The block cache holds the db's finalized block here.
+    bytes32_t wal_finalized_id{};
+    uint64_t wal_finalized_number = last_finalized_block_number;
+    // Set while tailing from the start of the WAL, whose oldest entries may
+    // refer to headers that have since been pruned
+    bool wal_from_start = false;
+    if (!wal_position.empty()) {
+        for (auto const &[id, entry] : block_cache) {
+            if (entry.block_number == last_finalized_block_number) {
+                wal_finalized_id = id;
+            }
+        }
+        wal_reader.emplace(chain, ledger_dir);
+        // Without a recorded position, resume after the entry that finalized
+        // the db's last finalized block, so that older entries are never read
+        auto const position = load_wal_position(wal_position);
+        WalEntry const resume_entry = position.value_or(WalEntry{
+            .action = WalAction::FINALIZE,
+            .id = std::bit_cast<evmc_bytes32>(wal_finalized_id)});
+        if ((position.has_value() || wal_finalized_id != bytes32_t{}) &&
+            wal_reader->rewind_to(resume_entry)) {
+            wal_reader->next_entries(1);
+        }
+        else {
+            if (position.has_value()) {
+                LOG_WARNING(
+                    "Position in {} is not in the WAL, tailing it from the "
+                    "start",
+                    wal_position);
+            }
+            wal_from_start = true;
+        }
+    }
+
+    auto const make_to_finalize = [](bytes32_t const &id, auto const &header) {
+        std::vector<uint64_t> verified_blocks;
+        for (BlockHeader const &h : header.delayed_execution_results) {
+            verified_blocks.push_back(h.number);
+        }
+        return ToFinalize{
+            .block = header.seqno,
+            .block_id = id,
+            .verified_blocks = std::move(verified_blocks)};
+    };
 
     while (finalized_block_num < end_block_num && stop == 0) {
         to_finalize.clear();
@@ -558,79 +680,174 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
 
         last_finalized_block_number = raw_db.get_latest_finalized_version();
 
-        // read from finalized head if we are behind
-        bytes32_t const finalized_head_id = for_each_header(
-            finalized_head,
-            header_dir,
-            chain,
-            last_finalized_block_number,
-            end_block_num,
-            [&raw_db, &to_execute, &to_finalize](
-                bytes32_t const &id, auto const &header) {
-                std::vector<uint64_t> verified_blocks;
-                for (BlockHeader const &h : header.delayed_execution_results) {
-                    verified_blocks.push_back(h.number);
-                }
-                to_finalize.push_front(ToFinalize{
-                    .block = header.seqno,
-                    .block_id = id,
-                    .verified_blocks = std::move(verified_blocks)});
-
-                if (!has_executed(raw_db, header, id)) {
-                    to_execute.push_front(
-                        ToExecute{.block_id = id, .header = header});
+        auto const discovery_begin = std::chrono::steady_clock::now();
+        size_t wal_entries_read = 0;
+        if (wal_reader.has_value()) {
+            std::vector<WalEntry> const entries =
+                wal_reader->next_entries(WAL_BATCH_SIZE);
+            wal_entries_read = entries.size();
+            auto const queued = [&to_execute](bytes32_t const &id) {
+                return std::ranges::any_of(
+                    to_execute,
+                    [&id](ToExecute const &e) { return e.block_id == id; });
+            };
+            for (WalEntry const &entry : entries) {
+                bytes32_t const id = std::bit_cast<bytes32_t>(entry.id);
+                if (MONAD_UNLIKELY(wal_from_start) &&
+                    !header_cache.contains(id) &&
+                    !std::filesystem::exists(header_dir / evmc::hex(id))) {
+                    // Only headers of long finalized blocks are pruned
+                    last_wal_entry = entry;
+                    continue;
                 }
-            });
-
-        // try reading from proposal head if we are caught up
-        if (to_finalize.empty()) {
-            for_each_header(
-                proposed_head,
+                std::visit(
+                    [&](auto const &header) {
+                        if (header.seqno > end_block_num) {
+                            return;
+                        }
+                        last_wal_entry = entry;
+                        if (header.seqno <= last_finalized_block_number) {
+                            return;
+                        }
+                        wal_from_start = false;
+                        // A finalized block is normally one this process
+                        // executed; only otherwise is the db asked
+                        bool const executed =
+                            block_cache.contains(id) || queued(id) ||
+                            ((probe_executed ||
+                              entry.action == WalAction::FINALIZE) &&
+                             has_executed(raw_db, header, id));
+                        // Canonical chain check: a proposal is executed only
+                        // on top of the finalized block or of a block that
+                        // was executed itself, so one on a stale fork never
+                        // reaches execution with its parent missing
+                        bytes32_t const parent_id = header.parent_id();
+                        bool const extends_chain =
+                            header.seqno == 1 ||
+                            (header.seqno == wal_finalized_number + 1 &&
+                                     wal_finalized_id != bytes32_t{}
+                                 ? parent_id == wal_finalized_id
+                                 : block_cache.contains(parent_id) ||
+                                       queued(parent_id));
+                        if (entry.action == WalAction::PROPOSE &&
+                            !extends_chain) {
+                            return;
+                        }
+                        if (!executed) {
+                            to_execute.push_back(
+                                ToExecute{.block_id = id, .header = header});
+                        }
+                        if (entry.action == WalAction::FINALIZE) {
+                            to_finalize.push_back(make_to_finalize(id, header));
+                            if (header.seqno > wal_finalized_number) {
+                                wal_finalized_id = id;
+                                wal_finalized_number = header.seqno;
+                            }
+                        }
+                    },
+                    load_header(header_cache, id, header_dir, chain));
+            }
+            if (!entries.empty()) {
+                probe_executed = false;
+            }
+        }
+        else {
+            // read from finalized head if we are behind
+            bytes32_t const finalized_head_id = for_each_header(
+                finalized_head,
                 header_dir,
                 chain,
+                header_cache,
                 last_finalized_block_number,
                 end_block_num,
-                [&raw_db,
-                 &to_execute,
-                 &finalized_head_id,
-                 &last_finalized_block_number](
+                [&raw_db, &to_execute, &to_finalize, &make_to_finalize](
                     bytes32_t const &id, auto const &header) {
-                    if (MONAD_UNLIKELY(
-                            header.seqno == last_finalized_block_number + 1 &&
-                            finalized_head_id != header.parent_id())) {
-                        // canonical chain check
-                        to_execute.clear();
-                    }
-                    else if (!has_executed(raw_db, header, id)) {
+                    to_finalize.push_front(make_to_finalize(id, header));
+
+                    if (!has_executed(raw_db, header, id)) {
                         to_execute.push_front(
                             ToExecute{.block_id = id, .header = header});
                     }
                 });
+
+            // try reading from proposal head if we are caught up
+            if (to_finalize.empty()) {
+                for_each_header(
+                    proposed_head,
+                    header_dir,
+                    chain,
+                    header_cache,
+                    last_finalized_block_number,
+                    end_block_num,
+                    [&raw_db,
+                     &to_execute,
+                     &finalized_head_id,
+                     &last_finalized_block_number](
+                        bytes32_t const &id, auto const &header) {
+                        if (MONAD_UNLIKELY(
+                                header.seqno ==
+                                    last_finalized_block_number + 1 &&
+                                finalized_head_id != header.parent_id())) {
+                            // canonical chain check
+                            to_execute.clear();
+                        }
+                        else if (!has_executed(raw_db, header, id)) {
+                            to_execute.push_front(
+                                ToExecute{.block_id = id, .header = header});
+                        }
+                    });
+            }
         }
+        exec_metrics()
+            .stage(BlockStage::Discovery)
+            .record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - discovery_begin));
 
         if (MONAD_UNLIKELY(to_execute.empty() && to_finalize.empty())) {
-            std::this_thread::sleep_for(SLEEP_TIME);
+            // A batch of skipped WAL entries says nothing about whether more
+            // are waiting, so only sleep once the WAL is drained
+            if (wal_entries_read == 0 && ledger_watcher.wait()) {
+                woken = true;
+            }
             continue;
         }
+        if (woken && !to_execute.empty()) {
+            // Measured from when consensus wrote the header, so that the
+            // notification delay is included, not just discovery
+            bytes32_t const &id = to_execute.front().block_id;
+            std::error_code ec;
+            auto const written = std::filesystem::last_write_time(
+                header_dir / evmc::hex(id), ec);
+            if (!ec) {
+                LOG_INFO(
+                    "__wakeup,id={},lat={}",
+                    id,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::file_clock::now() - written));
+            }
+        }
+        woken = false;
 
         auto const handle_to_execute =
-            [&body_dir,
-             &block_hash_chain,
+            [&block_hash_chain,
              &db,
              &chain,
              &vm,
              &priority_pool,
+             &scratch_pool,
              &last_finalized_block_number,
              chain_id,
              start_block_num,
              enable_tracing,
              &block_cache](
                 bytes32_t const &block_id,
-                auto const &header) -> Result<std::pair<uint64_t, uint64_t>> {
+                auto const &header,
+                IngestedBlock ingested)
+            -> Result<std::pair<uint64_t, uint64_t>> {
             auto const block_time_start = std::chrono::steady_clock::now();
 
             uint64_t const block_number = header.execution_inputs.number;
-            auto body = read_body(header.block_body_id, body_dir);
+            auto &body = ingested.body;
             auto const ntxns = body.transactions.size();
 
             auto const &block_hash_buffer =
@@ -675,9 +892,12 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
                     db,
                     vm,
                     priority_pool,
+                    scratch_pool,
                     block_number == start_block_num,
                     enable_tracing,
-                    block_cache);
+                    block_cache,
+                    ingested.recovered,
+                    ingested.sender_recovery_time);
                 MONAD_ABORT_PRINTF("handled rev value %d", rev);
             };
             BOOST_OUTCOME_TRY(
@@ -697,19 +917,52 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
             return outcome::success();
         };
 
+        // Queue every body up front; the pipeline reads, decodes and recovers
+        // senders for up to its depth of blocks behind the one currently
+        // executing. Bodies already pushed by an earlier iteration are not
+        // ingested again.
+        for (auto const &[block_id, consensus_header] : to_execute) {
+            std::visit(
+                [&ingest_pipeline](auto const &header) {
+                    ingest_pipeline.push(header.block_body_id, header.seqno);
+                },
+                consensus_header);
+        }
+
         for (auto const &[block_id, consensus_header] : to_execute) {
+            IngestPipelineDepths const depths = ingest_pipeline.depths();
+            ExecMetrics &metrics = exec_metrics();
+            metrics.ingest_queued.set(static_cast<int64_t>(depths.queued));
+            metrics.ingest_reading.set(static_cast<int64_t>(depths.reading));
+            metrics.ingest_recovering.set(
+                static_cast<int64_t>(depths.recovering));
+            metrics.ingest_ready.set(static_cast<int64_t>(depths.ready));
             BOOST_OUTCOME_TRY(std::visit(
-                [&block_id, handle_to_execute](auto const &header) {
-                    return handle_to_execute(block_id, header);
+                [&block_id, &ingest_pipeline, handle_to_execute](
+                    auto const &header) {
+                    return handle_to_execute(
+                        block_id,
+                        header,
+                        ingest_pipeline.pop(
+                            header.block_body_id, header.seqno));
                 },
                 consensus_header));
         }
+        if (to_execute.size() > 1) {
+            LOG_INFO(
+                "Ingested {} blocks, executor stalled on ingest for {} in "
+                "total",
+                to_execute.size(),
+                ingest_pipeline.stall_time());
+        }
 
         for (auto const &[block, block_id, verified_blocks] : to_finalize) {
             LOG_INFO(
                 "Processing finalization for block {} with block_id {}",
                 block,
                 block_id);
+            PerfScope const perf{
+                PerfStage::Finalization, block, perf_id(block_id)};
             db.finalize(block, block_id);
             block_hash_chain.finalize(block_id);
             record_block_finalized(block_id, block);
@@ -723,6 +976,21 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
         }
 
         if (!to_finalize.empty()) {
+            ingest_pipeline.discard_through(to_finalize.back().block);
+            if (!senders_checkpoint.empty()) {
+                unsaved_finalized_id = to_finalize.back().block_id;
+                auto const now = std::chrono::steady_clock::now();
+                if (now - senders_checkpoint_saved >=
+                    SENDERS_CHECKPOINT_INTERVAL) {
+                    save_finalized_senders(
+                        senders_checkpoint,
+                        chain_id,
+                        block_cache,
+                        unsaved_finalized_id.value());
+                    senders_checkpoint_saved = now;
+                    unsaved_finalized_id.reset();
+                }
+            }
             std::erase_if(
                 block_cache,
                 [last_finalized = to_finalize.back().block](
@@ -730,9 +998,34 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad(
                     return last_finalized > 1 &&
                            entry.second.block_number < last_finalized - 1;
                 });
+            // Walks never go below the last finalized header, so anything
+            // older is unreachable, including abandoned forks
+            std::erase_if(
+                header_cache,
+                [last_finalized = to_finalize.back().block](
+                    std::pair<bytes32_t, ConsensusHeader> const &entry) {
+                    return std::visit(
+                        [last_finalized](auto const &header) {
+                            return header.seqno < last_finalized;
+                        },
+                        entry.second);
+                });
+        }
+
+        if (last_wal_entry.has_value()) {
+            save_wal_position(wal_position, last_wal_entry.value());
+            last_wal_entry.reset();
         }
     }
 
+    if (unsaved_finalized_id.has_value()) {
+        save_finalized_senders(
+            senders_checkpoint,
+            chain_id,
+            block_cache,
+            unsaved_finalized_id.value());
+    }
+
     return {ntxs, total_gas};
 }
 
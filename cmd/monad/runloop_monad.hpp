@@ -30,6 +30,7 @@ MONAD_NAMESPACE_BEGIN
 struct MonadChain;
 struct Db;
 class BlockHashBufferFinalized;
+class SenderCache;
 
 namespace mpt
 {
@@ -43,7 +44,9 @@ namespace fiber
 
 Result<std::pair<uint64_t, uint64_t>> runloop_monad(
     MonadChain const &, std::filesystem::path const &, mpt::Db &, Db &,
-    vm::VM &, BlockHashBufferFinalized &, fiber::PriorityPool &, uint64_t &,
-    uint64_t, sig_atomic_t const volatile &, bool enable_tracing);
+    vm::VM &, BlockHashBufferFinalized &, fiber::PriorityPool &, SenderCache &,
+    uint64_t &, uint64_t, sig_atomic_t const volatile &, bool enable_tracing,
+    std::filesystem::path const &senders_checkpoint,
+    std::filesystem::path const &wal_position);
 
 MONAD_NAMESPACE_END
@@ -14,11 +14,17 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "runloop_monad_ethblocks.hpp"
+#include "block_scratch.hpp"
+#include "metrics.hpp"
+#include "perf_timeline.hpp"
+#include "sender_cache.hpp"
+#include "senders_checkpoint.hpp"
 
 #include <category/core/assert.h>
 #include <category/core/bytes.hpp>
 #include <category/core/config.hpp>
 #include <category/core/fiber/priority_pool.hpp>
+#include <category/core/int.hpp>
 #include <category/core/keccak.hpp>
 #include <category/core/procfs/statm.h>
 #include <category/execution/ethereum/block_hash_buffer.hpp>
@@ -47,6 +53,7 @@
 #include <chrono>
 #include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
 MONAD_ANONYMOUS_NAMESPACE_BEGIN
@@ -86,7 +93,8 @@ template <Traits traits>
 Result<void> process_monad_block(
     MonadChain const &chain, Db &db, vm::VM &vm,
     BlockHashBufferFinalized &block_hash_buffer,
-    fiber::PriorityPool &priority_pool, Block &block, bytes32_t const &block_id,
+    fiber::PriorityPool &priority_pool, SenderCache &sender_cache,
+    BlockScratchPool &scratch_pool, Block &block, bytes32_t const &block_id,
     bytes32_t const &parent_block_id, bool const enable_tracing,
     ankerl::unordered_dense::segmented_set<Address> const
         *grandparent_senders_and_authorities,
@@ -104,14 +112,24 @@ Result<void> process_monad_block(
 
     // Sender and authority recovery
     auto const sender_recovery_begin = std::chrono::steady_clock::now();
-    auto const recovered_senders =
-        recover_senders(block.transactions, priority_pool);
-    auto const recovered_authorities =
-        recover_authorities(block.transactions, priority_pool);
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::Begin, block.header.number, 0);
+    auto const
+        [recovered_senders,
+         recovered_authorities,
+         senders_and_authorities,
+         sender_cache_hits] =
+            recover_senders_and_authorities(
+                block.transactions, priority_pool, sender_cache);
+    record_perf_marker(
+        PerfStage::SenderRecovery, PerfPhase::End, block.header.number, 0);
     [[maybe_unused]] auto const sender_recovery_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - sender_recovery_begin);
-    std::vector<Address> senders(block.transactions.size());
+    // Senders, tracers and call frame vectors, recycled across blocks
+    BlockScratch scratch =
+        scratch_pool.acquire(block.transactions, enable_tracing);
+    std::vector<Address> &senders = scratch.senders;
     for (unsigned i = 0; i < recovered_senders.size(); ++i) {
         if (recovered_senders[i].has_value()) {
             senders[i] = recovered_senders[i].value();
@@ -120,38 +138,9 @@ Result<void> process_monad_block(
             return TransactionError::MissingSender;
         }
     }
-    ankerl::unordered_dense::segmented_set<Address> senders_and_authorities;
-    for (Address const &sender : senders) {
-        senders_and_authorities.insert(sender);
-    }
-    for (std::vector<std::optional<Address>> const &authorities :
-         recovered_authorities) {
-        for (std::optional<Address> const &authority : authorities) {
-            if (authority.has_value()) {
-                senders_and_authorities.insert(authority.value());
-            }
-        }
-    }
     BOOST_OUTCOME_TRY(
         static_validate_monad_body<traits>(senders, block.transactions));
 
-    // Call tracer initialization
-    std::vector<std::vector<CallFrame>> call_frames{block.transactions.size()};
-    std::vector<std::unique_ptr<CallTracerBase>> call_tracers{
-        block.transactions.size()};
-    std::vector<std::unique_ptr<trace::StateTracer>> state_tracers{
-        block.transactions.size()};
-    for (unsigned i = 0; i < block.transactions.size(); ++i) {
-        call_tracers[i] =
-            enable_tracing
-                ? std::unique_ptr<CallTracerBase>{std::make_unique<CallTracer>(
-                      block.transactions[i], call_frames[i])}
-                : std::unique_ptr<CallTracerBase>{
-                      std::make_unique<NoopCallTracer>()};
-        state_tracers[i] = std::unique_ptr<trace::StateTracer>{
-            std::make_unique<trace::StateTracer>(std::monostate{})};
-    }
-
     senders_and_authorities_out = senders_and_authorities;
 
     MonadChainContext chain_context{
@@ -170,6 +159,8 @@ Result<void> process_monad_block(
 
     BlockMetrics block_metrics;
     BlockState block_state(db, vm);
+    record_perf_marker(
+        PerfStage::Execution, PerfPhase::Begin, block.header.number, 0);
     BOOST_OUTCOME_TRY(
         auto const receipts,
         execute_block<traits>(
@@ -181,8 +172,8 @@ Result<void> process_monad_block(
             block_hash_buffer,
             priority_pool.fiber_group(),
             block_metrics,
-            call_tracers,
-            state_tracers,
+            scratch.call_tracers,
+            scratch.state_tracers,
             [&chain, &block, &chain_context](
                 Address const &sender,
                 Transaction const &tx,
@@ -199,18 +190,26 @@ Result<void> process_monad_block(
                     chain_context);
             }));
 
+    record_perf_marker(
+        PerfStage::Execution, PerfPhase::End, block.header.number, 0);
+
     // Database commit of state changes (incl. Merkle root calculations)
     block_state.log_debug();
     auto const commit_begin = std::chrono::steady_clock::now();
+    record_perf_marker(
+        PerfStage::Commit, PerfPhase::Begin, block.header.number, 0);
     block_state.commit(
         block_id,
         block.header,
         receipts,
-        call_frames,
+        scratch.call_frames,
         senders,
         block.transactions,
         block.ommers,
         block.withdrawals);
+    record_perf_marker(
+        PerfStage::Commit, PerfPhase::End, block.header.number, 0);
+    scratch_pool.release(std::move(scratch));
     [[maybe_unused]] auto const commit_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - commit_begin);
@@ -226,21 +225,43 @@ Result<void> process_monad_block(
 
     // Commit prologue: database finalization, computation of the Ethereum
     // block hash to append to the circular hash buffer
-    db.finalize(block.header.number, block_id);
-    db.update_verified_block(block.header.number);
-    auto const eth_block_hash =
-        to_bytes(keccak256(rlp::encode_block_header(output_header)));
-    block_hash_buffer.set(block.header.number, eth_block_hash);
+    {
+        PerfScope const perf{PerfStage::Finalization, block.header.number};
+        db.finalize(block.header.number, block_id);
+        db.update_verified_block(block.header.number);
+    }
+    {
+        PerfScope const perf{PerfStage::HashBufferUpdate, block.header.number};
+        auto const eth_block_hash =
+            to_bytes(keccak256(rlp::encode_block_header(output_header)));
+        block_hash_buffer.set(block.header.number, eth_block_hash);
+    }
 
-    // Emit the block metrics log line
+    // Record the block metrics and emit the log line
     [[maybe_unused]] auto const block_time =
         std::chrono::duration_cast<std::chrono::microseconds>(
             std::chrono::steady_clock::now() - block_begin);
+    exec_metrics().record_block(BlockSample{
+        .block_number = block.header.number,
+        .transactions = block.transactions.size(),
+        .retries = block_metrics.num_retries(),
+        .gas_used = output_header.gas_used,
+        .sender_cache_hits = sender_cache_hits,
+        .sender_recovery_time = sender_recovery_time,
+        .tx_exec_time = block_metrics.tx_exec_time(),
+        .commit_time = commit_time,
+        .block_time = block_time});
+
+    auto const db_stats = db.print_stats();
+    auto const vm_block_counts = vm.print_and_reset_block_counts();
+    auto const vm_compiler_stats = vm.print_compiler_stats();
+    exec_metrics().record_stats(db_stats, vm_block_counts, vm_compiler_stats);
+
     LOG_INFO(
         "__exec_block,bl={:8},ts={}"
         ",tx={:5},rt={:4},rtp={:5.2f}%"
         ",sr={:>7},txe={:>8},cmt={:>8},tot={:>8},tpse={:5},tps={:5}"
-        ",gas={:9},gpse={:4},gps={:3}{}{}{}",
+        ",gas={:9},gpse={:4},gps={:3},sch={:5}{}{}{}",
         block.header.number,
         std::chrono::duration_cast<std::chrono::milliseconds>(
             block_start.time_since_epoch())
@@ -261,9 +282,10 @@ Result<void> process_monad_block(
         output_header.gas_used /
             (uint64_t)std::max(1L, block_metrics.tx_exec_time().count()),
         output_header.gas_used / (uint64_t)std::max(1L, block_time.count()),
-        db.print_stats(),
-        vm.print_and_reset_block_counts(),
-        vm.print_compiler_stats());
+        sender_cache_hits,
+        db_stats,
+        vm_block_counts,
+        vm_compiler_stats);
 
     return outcome_e::success();
 }
@@ -275,9 +297,10 @@ MONAD_NAMESPACE_BEGIN
 Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
     MonadChain const &chain, std::filesystem::path const &ledger_dir, Db &db,
     vm::VM &vm, BlockHashBufferFinalized &block_hash_buffer,
-    fiber::PriorityPool &priority_pool, uint64_t &finalized_block_num,
-    uint64_t const end_block_num, sig_atomic_t const volatile &stop,
-    bool const enable_tracing)
+    fiber::PriorityPool &priority_pool, SenderCache &sender_cache,
+    uint64_t &finalized_block_num, uint64_t const end_block_num,
+    sig_atomic_t const volatile &stop, bool const enable_tracing,
+    std::filesystem::path const &senders_checkpoint)
 {
     uint64_t const batch_size =
         end_block_num == std::numeric_limits<uint64_t>::max() ? 1 : 1000;
@@ -289,6 +312,7 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
     uint64_t ntxs = 0;
 
     BlockDb block_db(ledger_dir);
+    BlockScratchPool scratch_pool;
     bytes32_t parent_block_id{};
     uint64_t block_num = finalized_block_num;
 
@@ -297,70 +321,60 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
     std::optional<ankerl::unordered_dense::segmented_set<Address>>
         grandparent_senders_and_authorities;
 
-    if (block_num > 1) {
-        Block parent_block;
-        MONAD_ASSERT_PRINTF(
-            block_db.get(block_num - 1, parent_block),
-            "Could not query %lu from blockdb for parent",
-            block_num - 1);
-        auto const recovered_senders =
-            recover_senders(parent_block.transactions, priority_pool);
-        auto const recovered_authorities =
-            recover_authorities(parent_block.transactions, priority_pool);
-        std::vector<Address> senders(parent_block.transactions.size());
-        for (unsigned j = 0; j < recovered_senders.size(); ++j) {
-            if (recovered_senders[j].has_value()) {
-                senders[j] = recovered_senders[j].value();
+    constexpr auto SENDERS_CHECKPOINT_INTERVAL = std::chrono::seconds(5);
+    uint256_t const chain_id = chain.get_chain_id();
+
+    if (!senders_checkpoint.empty()) {
+        for (auto &entry :
+             load_senders_checkpoint(senders_checkpoint, chain_id)) {
+            if (block_num > 1 && entry.block_number == block_num - 1) {
+                parent_senders_and_authorities =
+                    std::move(entry.senders_and_authorities);
             }
-        }
-        ankerl::unordered_dense::segmented_set<Address> parent_set;
-        for (Address const &sender : senders) {
-            parent_set.insert(sender);
-        }
-        for (std::vector<std::optional<Address>> const &authorities :
-             recovered_authorities) {
-            for (std::optional<Address> const &authority : authorities) {
-                if (authority.has_value()) {
-                    parent_set.insert(authority.value());
-                }
+            else if (block_num > 2 && entry.block_number == block_num - 2) {
+                grandparent_senders_and_authorities =
+                    std::move(entry.senders_and_authorities);
             }
         }
-        parent_senders_and_authorities = std::move(parent_set);
-
-        if (block_num > 2) {
-            Block grandparent_block;
-            MONAD_ASSERT_PRINTF(
-                block_db.get(block_num - 2, grandparent_block),
-                "Could not query %lu from blockdb for grandparent",
-                block_num - 2);
-            auto const grandparent_recovered_senders =
-                recover_senders(grandparent_block.transactions, priority_pool);
-            auto const grandparent_recovered_authorities = recover_authorities(
-                grandparent_block.transactions, priority_pool);
-            std::vector<Address> grandparent_senders(
-                grandparent_block.transactions.size());
-            for (unsigned j = 0; j < grandparent_recovered_senders.size();
-                 ++j) {
-                if (grandparent_recovered_senders[j].has_value()) {
-                    grandparent_senders[j] =
-                        grandparent_recovered_senders[j].value();
-                }
-            }
-            ankerl::unordered_dense::segmented_set<Address> grandparent_set;
-            for (Address const &sender : grandparent_senders) {
-                grandparent_set.insert(sender);
-            }
-            for (std::vector<std::optional<Address>> const &authorities :
-                 grandparent_recovered_authorities) {
-                for (std::optional<Address> const &authority : authorities) {
-                    if (authority.has_value()) {
-                        grandparent_set.insert(authority.value());
-                    }
-                }
+    }
+
+    auto const recover_ancestor = [&](uint64_t const n) {
+        Block ancestor;
+        MONAD_ASSERT_PRINTF(
+            block_db.get(n, ancestor),
+            "Could not query %lu from blockdb for ancestor",
+            n);
+        return recover_senders_and_authorities(
+                   ancestor.transactions, priority_pool, sender_cache)
+            .senders_and_authorities;
+    };
+    if (block_num > 1 && !parent_senders_and_authorities.has_value()) {
+        parent_senders_and_authorities = recover_ancestor(block_num - 1);
+    }
+    if (block_num > 2 && !grandparent_senders_and_authorities.has_value()) {
+        grandparent_senders_and_authorities = recover_ancestor(block_num - 2);
+    }
+
+    // Persists the sets of the last executed block and its parent; replay
+    // runs through thousands of blocks a second, so this is throttled and a
+    // crash merely costs recovering two blocks on the next start
+    auto const save_checkpoint = [&] {
+        std::vector<SendersCheckpointEntry> entries;
+        for (auto const &[n, senders] :
+             {std::pair{block_num - 1, &parent_senders_and_authorities},
+              std::pair{block_num - 2, &grandparent_senders_and_authorities}}) {
+            if (senders->has_value()) {
+                entries.emplace_back(SendersCheckpointEntry{
+                    .block_number = n,
+                    .block_id = bytes32_t{n},
+                    .parent_id = n > 0 ? bytes32_t{n - 1} : bytes32_t{},
+                    .senders_and_authorities = senders->value()});
             }
-            grandparent_senders_and_authorities = std::move(grandparent_set);
         }
-    }
+        save_senders_checkpoint(senders_checkpoint, chain_id, entries);
+    };
+    bool senders_checkpoint_unsaved = false;
+    auto senders_checkpoint_saved = std::chrono::steady_clock::now();
 
     while (block_num <= end_block_num && stop == 0) {
         Block block;
@@ -382,6 +396,8 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
                 vm,
                 block_hash_buffer,
                 priority_pool,
+                sender_cache,
+                scratch_pool,
                 block,
                 block_id,
                 parent_block_id,
@@ -421,12 +437,27 @@ Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
 
         parent_block_id = block_id;
         ++block_num;
+
+        if (!senders_checkpoint.empty()) {
+            senders_checkpoint_unsaved = true;
+            auto const now = std::chrono::steady_clock::now();
+            if (now - senders_checkpoint_saved >=
+                SENDERS_CHECKPOINT_INTERVAL) {
+                save_checkpoint();
+                senders_checkpoint_saved = now;
+                senders_checkpoint_unsaved = false;
+            }
+        }
     }
     if (batch_num_blocks > 0) {
         log_tps(
             block_num, batch_num_blocks, batch_num_txs, batch_gas, batch_begin);
     }
     finalized_block_num = block_num;
+
+    if (senders_checkpoint_unsaved) {
+        save_checkpoint();
+    }
     return {ntxs, total_gas};
 }
 
@@ -31,6 +31,7 @@ MONAD_NAMESPACE_BEGIN
 struct MonadChain;
 struct Db;
 class BlockHashBufferFinalized;
+class SenderCache;
 
 namespace fiber
 {
@@ -39,7 +40,8 @@ namespace fiber
 
 Result<std::pair<uint64_t, uint64_t>> runloop_monad_ethblocks(
     MonadChain const &, std::filesystem::path const &, Db &, vm::VM &,
-    BlockHashBufferFinalized &, fiber::PriorityPool &, uint64_t &, uint64_t,
-    sig_atomic_t const volatile &, bool enable_tracing);
+    BlockHashBufferFinalized &, fiber::PriorityPool &, SenderCache &,
+    uint64_t &, uint64_t, sig_atomic_t const volatile &, bool enable_tracing,
+    std::filesystem::path const &senders_checkpoint);
 
 MONAD_NAMESPACE_END
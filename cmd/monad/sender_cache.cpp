@@ -0,0 +1,367 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "sender_cache.hpp"
+#include "file_io.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/blake3.hpp>
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/core/fiber/priority_pool.hpp>
+#include <category/core/keccak.hpp>
+#include <category/execution/ethereum/core/rlp/transaction_rlp.hpp>
+#include <category/execution/ethereum/core/transaction.hpp>
+
+#include <boost/fiber/future/promise.hpp>
+#include <quill/Quill.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Sidecar layout: magic, the chain id, a record count, then per record the
+// tx hash, the sender, an authority count and per authority a presence byte
+// and an address, and finally the blake3 of everything before it. All
+// integers are little endian. The senders go straight into execution, so a
+// file that fails any check is discarded as a whole.
+constexpr uint64_t SIDECAR_MAGIC = 0x3265686361637364; // "dscache2"
+
+constexpr size_t AUTHORITY_SIZE = sizeof(uint8_t) + sizeof(Address);
+constexpr size_t MIN_RECORD_SIZE =
+    sizeof(bytes32_t) + sizeof(Address) + sizeof(uint32_t);
+
+template <class T>
+void append_pod(byte_string &out, T const &v)
+{
+    out.append(reinterpret_cast<unsigned char const *>(&v), sizeof(T));
+}
+
+template <class T>
+bool take_pod(byte_string_view &in, T &v)
+{
+    if (in.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&v, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+}
+
+// Parses the records of a sidecar whose checksum and header were verified;
+// nullopt if any count disagrees with the bytes that are actually there
+std::optional<std::vector<std::pair<bytes32_t, SenderCache::Entry>>>
+parse_records(byte_string_view in, uint64_t const count)
+{
+    if (count > in.size() / MIN_RECORD_SIZE) {
+        return std::nullopt;
+    }
+    std::vector<std::pair<bytes32_t, SenderCache::Entry>> records;
+    records.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        bytes32_t tx_hash;
+        SenderCache::Entry entry;
+        uint32_t nauthorities;
+        if (!take_pod(in, tx_hash) || !take_pod(in, entry.sender) ||
+            !take_pod(in, nauthorities) ||
+            nauthorities > in.size() / AUTHORITY_SIZE) {
+            return std::nullopt;
+        }
+        entry.authorities.reserve(nauthorities);
+        for (uint32_t j = 0; j < nauthorities; ++j) {
+            uint8_t present;
+            Address authority;
+            if (!take_pod(in, present) || !take_pod(in, authority) ||
+                present > 1) {
+                return std::nullopt;
+            }
+            entry.authorities.emplace_back(
+                present ? std::optional{authority} : std::nullopt);
+        }
+        records.emplace_back(tx_hash, std::move(entry));
+    }
+    if (!in.empty()) {
+        return std::nullopt;
+    }
+    return records;
+}
+
+// Transactions are recovered in contiguous batches, one pool job per batch,
+// so that large blocks do not pay a fiber dispatch and a promise round trip
+// for every signature. Batches shrink with the block so that small blocks
+// still spread across every pool thread.
+constexpr size_t MAX_RECOVERY_BATCH_SIZE = 32;
+constexpr size_t MIN_RECOVERY_BATCHES = 64;
+
+size_t recovery_batch_size(size_t const ntxs)
+{
+    return std::clamp(
+        ntxs / MIN_RECOVERY_BATCHES, size_t{1}, MAX_RECOVERY_BATCH_SIZE);
+}
+
+// Returns true if the transaction was served from the cache
+bool recover_transaction(
+    Transaction const &tx, SenderCache &cache, std::optional<Address> &sender,
+    std::vector<std::optional<Address>> &authorities)
+{
+    bytes32_t const tx_hash = to_bytes(keccak256(rlp::encode_transaction(tx)));
+    if (auto entry = cache.find(tx_hash); entry.has_value()) {
+        sender = entry->sender;
+        authorities = std::move(entry->authorities);
+        return true;
+    }
+    sender = recover_sender(tx);
+    authorities.reserve(tx.authorization_list.size());
+    for (auto const &authorization : tx.authorization_list) {
+        authorities.emplace_back(recover_authority(authorization));
+    }
+    // A transaction without a sender is invalid and fails its block; there is
+    // no point remembering it
+    if (sender.has_value()) {
+        cache.insert(
+            tx_hash,
+            SenderCache::Entry{
+                .sender = sender.value(), .authorities = authorities});
+    }
+    return false;
+}
+
+void fsync_path(std::filesystem::path const &path)
+{
+    int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    MONAD_ASSERT_PRINTF(
+        fd != -1, "open %s failed: %s", path.c_str(), strerror(errno));
+    MONAD_ASSERT_PRINTF(
+        fsync(fd) == 0, "fsync %s failed: %s", path.c_str(), strerror(errno));
+    (void)close(fd);
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+SenderCache::SenderCache(size_t const capacity)
+    : shard_capacity_{std::max(capacity / NUM_SHARDS, size_t{1})}
+{
+}
+
+SenderCache::Shard &SenderCache::shard(bytes32_t const &tx_hash)
+{
+    // Transaction hashes are keccak outputs, so any byte is uniform
+    return shards_[tx_hash.bytes[0] % NUM_SHARDS];
+}
+
+std::optional<SenderCache::Entry> SenderCache::find(bytes32_t const &tx_hash)
+{
+    Shard &s = shard(tx_hash);
+    {
+        std::lock_guard const lock{s.mutex};
+        if (auto const it = s.entries.find(tx_hash); it != s.entries.end()) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void SenderCache::insert(bytes32_t const &tx_hash, Entry entry)
+{
+    Shard &s = shard(tx_hash);
+    std::lock_guard const lock{s.mutex};
+    if (!s.entries.try_emplace(tx_hash, std::move(entry)).second) {
+        return;
+    }
+    s.insertion_order.push_back(tx_hash);
+    while (s.insertion_order.size() > shard_capacity_) {
+        s.entries.erase(s.insertion_order.front());
+        s.insertion_order.pop_front();
+    }
+}
+
+size_t SenderCache::size()
+{
+    size_t n = 0;
+    for (Shard &s : shards_) {
+        std::lock_guard const lock{s.mutex};
+        n += s.entries.size();
+    }
+    return n;
+}
+
+void SenderCache::load(
+    std::filesystem::path const &path, uint256_t const &chain_id)
+{
+    if (!std::filesystem::exists(path)) {
+        return;
+    }
+    byte_string buf;
+    byte_string_view const data = read_whole_file(path, buf);
+    size_t const header_size =
+        sizeof(SIDECAR_MAGIC) + sizeof(uint256_t) + sizeof(uint64_t);
+    if (data.size() < header_size + sizeof(bytes32_t)) {
+        LOG_WARNING("Ignoring truncated sender cache file {}", path);
+        return;
+    }
+    byte_string_view const body{data.data(), data.size() - sizeof(bytes32_t)};
+    bytes32_t checksum;
+    std::memcpy(checksum.bytes, data.data() + body.size(), sizeof(checksum));
+    if (to_bytes(blake3(body)) != checksum) {
+        LOG_WARNING("Ignoring sender cache file {} with bad checksum", path);
+        return;
+    }
+    byte_string_view in = body;
+    uint64_t magic;
+    uint256_t file_chain_id;
+    uint64_t count;
+    take_pod(in, magic);
+    take_pod(in, file_chain_id);
+    take_pod(in, count);
+    if (magic != SIDECAR_MAGIC || file_chain_id != chain_id) {
+        LOG_WARNING(
+            "Ignoring sender cache file {} of another format or chain", path);
+        return;
+    }
+    auto records = parse_records(in, count);
+    if (!records.has_value()) {
+        LOG_WARNING("Ignoring malformed sender cache file {}", path);
+        return;
+    }
+    for (auto &[tx_hash, entry] : records.value()) {
+        insert(tx_hash, std::move(entry));
+    }
+    LOG_INFO("Loaded {} recovered senders from {}", count, path);
+}
+
+void SenderCache::save(
+    std::filesystem::path const &path, uint256_t const &chain_id)
+{
+    byte_string out;
+    append_pod(out, SIDECAR_MAGIC);
+    append_pod(out, chain_id);
+    append_pod(out, static_cast<uint64_t>(size()));
+    // Entries may not be inserted concurrently with save, which runs at
+    // shutdown, so the count written above stays accurate
+    for (Shard &s : shards_) {
+        std::lock_guard const lock{s.mutex};
+        for (auto const &[tx_hash, entry] : s.entries) {
+            append_pod(out, tx_hash);
+            append_pod(out, entry.sender);
+            append_pod(out, static_cast<uint32_t>(entry.authorities.size()));
+            for (std::optional<Address> const &authority :
+                 entry.authorities) {
+                append_pod(out, static_cast<uint8_t>(authority.has_value()));
+                append_pod(out, authority.value_or(Address{}));
+            }
+        }
+    }
+    append_pod(out, to_bytes(blake3(out)));
+
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        MONAD_ASSERT_PRINTF(
+            os, "could not open sender cache file %s", tmp_path.c_str());
+        os.write(reinterpret_cast<char const *>(out.data()), out.size());
+        MONAD_ASSERT_PRINTF(
+            os.flush(), "could not write sender cache file %s", path.c_str());
+    }
+    // Without it, a crash can leave the renamed file empty
+    fsync_path(tmp_path);
+    std::filesystem::rename(tmp_path, path);
+    fsync_path(
+        path.has_parent_path() ? path.parent_path()
+                               : std::filesystem::path{"."});
+}
+
+RecoveredSenders recover_senders_and_authorities(
+    std::vector<Transaction> const &transactions,
+    fiber::PriorityPool &priority_pool, SenderCache &cache)
+{
+    RecoveredSenders result;
+    result.senders.resize(transactions.size());
+    result.authorities.resize(transactions.size());
+    std::atomic<size_t> cache_hits{0};
+
+    size_t const batch_size = recovery_batch_size(transactions.size());
+    size_t const num_batches =
+        (transactions.size() + batch_size - 1) / batch_size;
+    std::shared_ptr<boost::fibers::promise<void>[]> promises{
+        new boost::fibers::promise<void>[num_batches]};
+    for (size_t batch = 0; batch < num_batches; ++batch) {
+        size_t const begin = batch * batch_size;
+        size_t const end = std::min(begin + batch_size, transactions.size());
+        priority_pool.submit(
+            begin,
+            [batch,
+             begin,
+             end,
+             &transactions,
+             &result,
+             &cache,
+             &cache_hits,
+             promises] {
+                size_t hits = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    hits += recover_transaction(
+                        transactions[i],
+                        cache,
+                        result.senders[i],
+                        result.authorities[i]);
+                }
+                cache_hits.fetch_add(hits, std::memory_order_relaxed);
+                promises[batch].set_value();
+            });
+    }
+    // Build the deduplicated sender and authority set on this thread while
+    // the pool is still recovering later batches, instead of in a separate
+    // pass after every batch has finished
+    for (size_t batch = 0; batch < num_batches; ++batch) {
+        promises[batch].get_future().wait();
+        size_t const begin = batch * batch_size;
+        size_t const end = std::min(begin + batch_size, transactions.size());
+        for (size_t i = begin; i < end; ++i) {
+            if (result.senders[i].has_value()) {
+                result.senders_and_authorities.insert(
+                    result.senders[i].value());
+            }
+            for (std::optional<Address> const &authority :
+                 result.authorities[i]) {
+                if (authority.has_value()) {
+                    result.senders_and_authorities.insert(authority.value());
+                }
+            }
+        }
+    }
+    result.cache_hits = cache_hits.load(std::memory_order_relaxed);
+    return result;
+}
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,125 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/bytes.hpp>
+#include <category/core/int.hpp>
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+#include <category/execution/ethereum/core/transaction.hpp>
+
+#include <ankerl/unordered_dense.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+namespace fiber
+{
+    class PriorityPool;
+}
+
+/// Bounded, concurrent cache of recovered transaction senders and EIP-7702
+/// authorities, keyed by transaction hash. Competing proposals at the same
+/// height, blocks re-read at startup and parents re-loaded by the eth-blocks
+/// runloop mostly carry transactions that were already recovered once.
+class SenderCache
+{
+public:
+    struct Entry
+    {
+        Address sender;
+        std::vector<std::optional<Address>> authorities;
+    };
+
+private:
+    static constexpr size_t NUM_SHARDS = 64;
+
+    // Each shard evicts in insertion order once it reaches its share of the
+    // capacity; recovery results never change, so there is no invalidation
+    struct Shard
+    {
+        std::mutex mutex;
+        ankerl::unordered_dense::map<bytes32_t, Entry> entries;
+        std::deque<bytes32_t> insertion_order;
+    };
+
+    size_t const shard_capacity_;
+    std::array<Shard, NUM_SHARDS> shards_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard &shard(bytes32_t const &tx_hash);
+
+public:
+    explicit SenderCache(size_t capacity);
+
+    SenderCache(SenderCache const &) = delete;
+    SenderCache &operator=(SenderCache const &) = delete;
+
+    std::optional<Entry> find(bytes32_t const &tx_hash);
+
+    void insert(bytes32_t const &tx_hash, Entry);
+
+    size_t size();
+
+    /// Load entries from a sidecar file written by `save` for the same
+    /// chain. A missing file is not an error; one that is corrupt, of
+    /// another format or of another chain is ignored as a whole with a
+    /// warning.
+    void load(std::filesystem::path const &, uint256_t const &chain_id);
+
+    /// Write all entries to a checksummed sidecar file, replacing it
+    /// atomically
+    void save(std::filesystem::path const &, uint256_t const &chain_id);
+
+    uint64_t hits() const
+    {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t misses() const
+    {
+        return misses_.load(std::memory_order_relaxed);
+    }
+};
+
+struct RecoveredSenders
+{
+    std::vector<std::optional<Address>> senders;
+    std::vector<std::vector<std::optional<Address>>> authorities;
+    /// Every recovered sender and authority of the block, deduplicated
+    ankerl::unordered_dense::segmented_set<Address> senders_and_authorities;
+    size_t cache_hits; ///< transactions served from the cache
+};
+
+/// Fused replacement for `recover_senders` followed by `recover_authorities`:
+/// the senders and authorities of every transaction are recovered as one job
+/// set on the pool, consulting `cache` by transaction hash before running
+/// ecrecover, and `senders_and_authorities` is built as the jobs complete
+RecoveredSenders recover_senders_and_authorities(
+    std::vector<Transaction> const &, fiber::PriorityPool &, SenderCache &);
+
+MONAD_NAMESPACE_END
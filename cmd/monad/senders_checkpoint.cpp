@@ -0,0 +1,180 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "senders_checkpoint.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/blake3.hpp>
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/core/int.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+
+#include <quill/Quill.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Layout: magic, the chain id, an entry count, then per entry the block
+// number, block id, parent id, an address count and the addresses, and
+// finally the blake3 of everything before it. All integers are little
+// endian. The sets feed reserve balance checks, so a file that fails any
+// check is discarded as a whole.
+constexpr uint64_t CHECKPOINT_MAGIC = 0x3274706b63736473; // "sdsckpt2"
+
+constexpr size_t MIN_ENTRY_SIZE = sizeof(uint64_t) + sizeof(bytes32_t) +
+                                  sizeof(bytes32_t) + sizeof(uint64_t);
+
+template <class T>
+void append_pod(byte_string &out, T const &v)
+{
+    out.append(reinterpret_cast<unsigned char const *>(&v), sizeof(T));
+}
+
+template <class T>
+bool take_pod(byte_string_view &in, T &v)
+{
+    if (in.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&v, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+}
+
+// Parses the entries of a checkpoint whose checksum and header were
+// verified; nullopt if any count disagrees with the bytes that are actually
+// there
+std::optional<std::vector<SendersCheckpointEntry>>
+parse_entries(byte_string_view in, uint64_t const count)
+{
+    if (count > in.size() / MIN_ENTRY_SIZE) {
+        return std::nullopt;
+    }
+    std::vector<SendersCheckpointEntry> entries;
+    entries.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        SendersCheckpointEntry entry;
+        uint64_t naddresses;
+        if (!take_pod(in, entry.block_number) ||
+            !take_pod(in, entry.block_id) || !take_pod(in, entry.parent_id) ||
+            !take_pod(in, naddresses) ||
+            naddresses > in.size() / sizeof(Address)) {
+            return std::nullopt;
+        }
+        entry.senders_and_authorities.reserve(naddresses);
+        for (uint64_t j = 0; j < naddresses; ++j) {
+            Address address;
+            take_pod(in, address);
+            entry.senders_and_authorities.insert(address);
+        }
+        entries.emplace_back(std::move(entry));
+    }
+    if (!in.empty()) {
+        return std::nullopt;
+    }
+    return entries;
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+void save_senders_checkpoint(
+    std::filesystem::path const &path, uint256_t const &chain_id,
+    std::span<SendersCheckpointEntry const> const entries)
+{
+    byte_string out;
+    append_pod(out, CHECKPOINT_MAGIC);
+    append_pod(out, chain_id);
+    append_pod(out, static_cast<uint64_t>(entries.size()));
+    for (SendersCheckpointEntry const &entry : entries) {
+        append_pod(out, entry.block_number);
+        append_pod(out, entry.block_id);
+        append_pod(out, entry.parent_id);
+        append_pod(
+            out, static_cast<uint64_t>(entry.senders_and_authorities.size()));
+        for (Address const &address : entry.senders_and_authorities) {
+            append_pod(out, address);
+        }
+    }
+    append_pod(out, to_bytes(blake3(out)));
+
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        MONAD_ASSERT_PRINTF(
+            os, "could not open senders checkpoint %s", tmp_path.c_str());
+        os.write(reinterpret_cast<char const *>(out.data()), out.size());
+        MONAD_ASSERT_PRINTF(
+            os.flush(), "could not write senders checkpoint %s", path.c_str());
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+std::vector<SendersCheckpointEntry> load_senders_checkpoint(
+    std::filesystem::path const &path, uint256_t const &chain_id)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        return {};
+    }
+    byte_string const data{
+        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+    size_t const header_size =
+        sizeof(CHECKPOINT_MAGIC) + sizeof(uint256_t) + sizeof(uint64_t);
+    if (data.size() < header_size + sizeof(bytes32_t)) {
+        LOG_WARNING("Ignoring truncated senders checkpoint {}", path);
+        return {};
+    }
+    byte_string_view const body{data.data(), data.size() - sizeof(bytes32_t)};
+    bytes32_t checksum;
+    std::memcpy(checksum.bytes, data.data() + body.size(), sizeof(checksum));
+    if (to_bytes(blake3(body)) != checksum) {
+        LOG_WARNING("Ignoring senders checkpoint {} with bad checksum", path);
+        return {};
+    }
+    byte_string_view in = body;
+    uint64_t magic;
+    uint256_t file_chain_id;
+    uint64_t count;
+    take_pod(in, magic);
+    take_pod(in, file_chain_id);
+    take_pod(in, count);
+    if (magic != CHECKPOINT_MAGIC || file_chain_id != chain_id) {
+        LOG_WARNING(
+            "Ignoring senders checkpoint {} of another format or chain", path);
+        return {};
+    }
+    auto entries = parse_entries(in, count);
+    if (!entries.has_value()) {
+        LOG_WARNING("Ignoring malformed senders checkpoint {}", path);
+        return {};
+    }
+    return std::move(entries).value();
+}
+
+MONAD_NAMESPACE_END
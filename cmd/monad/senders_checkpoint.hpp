@@ -0,0 +1,54 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/core/int.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+
+#include <ankerl/unordered_dense.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Senders and EIP-7702 authorities of one executed block; the reserve
+/// balance checks of its child and grandchild need them
+struct SendersCheckpointEntry
+{
+    uint64_t block_number;
+    bytes32_t block_id;
+    bytes32_t parent_id;
+    ankerl::unordered_dense::segmented_set<Address> senders_and_authorities;
+};
+
+/// Atomically replaces the checkpoint file at `path` with `entries`
+void save_senders_checkpoint(
+    std::filesystem::path const &path, uint256_t const &chain_id,
+    std::span<SendersCheckpointEntry const> entries);
+
+/// Loads a checkpoint written by save_senders_checkpoint for the same chain.
+/// A missing, truncated or corrupt file, or one whose checksum, format or
+/// chain does not match, yields no entries, in which case the caller
+/// recovers the sets from the blocks as before.
+std::vector<SendersCheckpointEntry> load_senders_checkpoint(
+    std::filesystem::path const &path, uint256_t const &chain_id);
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,519 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "snapshot_container.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+
+#include <blake3.h>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#include <quill/Quill.h>
+#include <quill/bundled/fmt/format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Index layout: magic, format version, block version, chunk size, chunk
+// count, the chunks field by field, and the magic again so that a truncated
+// index is rejected. All integers are little endian.
+constexpr uint64_t INDEX_MAGIC = 0x7864696e7370616e; // "napsnidx"
+constexpr uint64_t FORMAT_VERSION = 1;
+
+// Resume log layout: magic, the blake3 of the container index, the target
+// id, then one shard number per durably inserted shard. A trailing partial
+// shard number, left by a crash mid-append, is ignored.
+constexpr uint64_t RESUME_MAGIC = 0x316d7372736e616e; // "nansrsm1"
+
+// Favours dump speed; snapshot records are mostly hashes and compress
+// little beyond this
+constexpr int BROTLI_QUALITY = 4;
+
+template <class T>
+void write_pod(std::ostream &os, T const &v)
+{
+    os.write(reinterpret_cast<char const *>(&v), sizeof(T));
+}
+
+template <class T>
+bool read_pod(std::istream &is, T &v)
+{
+    return static_cast<bool>(is.read(reinterpret_cast<char *>(&v), sizeof(T)));
+}
+
+bytes32_t blake3(byte_string_view const data)
+{
+    bytes32_t digest;
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    blake3_hasher_update(&hasher, data.data(), data.size());
+    blake3_hasher_finalize(&hasher, digest.bytes, sizeof(digest.bytes));
+    return digest;
+}
+
+void fsync_path(std::filesystem::path const &path)
+{
+    int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    MONAD_ASSERT_PRINTF(
+        fd != -1, "open %s failed: %s", path.c_str(), strerror(errno));
+    MONAD_ASSERT_PRINTF(
+        fsync(fd) == 0, "fsync %s failed: %s", path.c_str(), strerror(errno));
+    close(fd);
+}
+
+// Makes a new or renamed entry of `path`'s directory durable
+void fsync_parent(std::filesystem::path const &path)
+{
+    auto const parent = path.has_parent_path() ? path.parent_path()
+                                               : std::filesystem::path{"."};
+    fsync_path(parent);
+}
+
+bytes32_t index_id(std::filesystem::path const &dir)
+{
+    auto const path = dir / "index";
+    std::ifstream is(path, std::ios::binary);
+    byte_string const data{
+        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+    return blake3(data);
+}
+
+std::set<uint64_t> read_resume_log(
+    std::filesystem::path const &path, bytes32_t const &container_id,
+    bytes32_t const &target_id)
+{
+    std::set<uint64_t> loaded;
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        return loaded;
+    }
+    uint64_t magic;
+    bytes32_t log_container_id;
+    bytes32_t log_target_id;
+    if (!read_pod(is, magic) || magic != RESUME_MAGIC ||
+        !read_pod(is, log_container_id) || !read_pod(is, log_target_id) ||
+        log_container_id != container_id || log_target_id != target_id) {
+        LOG_WARNING(
+            "Ignoring resume log {} of another container or target", path);
+        return loaded;
+    }
+    for (uint64_t shard; read_pod(is, shard);) {
+        loaded.insert(shard);
+    }
+    return loaded;
+}
+
+byte_string read_stored(
+    int const fd, std::filesystem::path const &path, SnapshotChunk const &chunk)
+{
+    byte_string buf(chunk.stored_size, 0);
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t const r = pread(
+            fd,
+            buf.data() + done,
+            buf.size() - done,
+            static_cast<off_t>(chunk.offset + done));
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+        MONAD_ASSERT_PRINTF(
+            r > 0,
+            "read %s failed: %s",
+            path.c_str(),
+            r == 0 ? "unexpected end of file" : strerror(errno));
+        done += static_cast<size_t>(r);
+    }
+    return buf;
+}
+
+SnapshotShard read_shard(
+    int const fd, std::filesystem::path const &path, uint64_t const shard,
+    std::vector<SnapshotChunk> const &chunks)
+{
+    SnapshotShard result{.shard = shard, .streams = {}};
+    std::vector<uint32_t> next_sequence;
+    for (SnapshotChunk const &chunk : chunks) {
+        if (result.streams.size() <= chunk.type) {
+            result.streams.resize(chunk.type + 1);
+            next_sequence.resize(chunk.type + 1, 0);
+        }
+        byte_string &stream = result.streams[chunk.type];
+        // The index is sorted, so a gap in the sequence is a lost chunk
+        if (chunk.sequence != next_sequence[chunk.type]++) {
+            throw std::runtime_error(fmt::format(
+                "{} is missing chunks of shard {} type {}",
+                path.string(),
+                shard,
+                chunk.type));
+        }
+        byte_string const stored = read_stored(fd, path, chunk);
+        if (blake3(stored) != chunk.checksum) {
+            throw std::runtime_error(fmt::format(
+                "checksum mismatch in {} for shard {} type {} chunk {}",
+                path.string(),
+                shard,
+                chunk.type,
+                chunk.sequence));
+        }
+        if (chunk.codec == ChunkCodec::None) {
+            stream += stored;
+            continue;
+        }
+        MONAD_ASSERT(chunk.codec == ChunkCodec::Brotli);
+        size_t const begin = stream.size();
+        size_t size = chunk.size;
+        stream.resize(begin + size);
+        if (BrotliDecoderDecompress(
+                stored.size(), stored.data(), &size, stream.data() + begin) !=
+                BROTLI_DECODER_RESULT_SUCCESS ||
+            size != chunk.size) {
+            throw std::runtime_error(fmt::format(
+                "could not decompress {} shard {} type {} chunk {}",
+                path.string(),
+                shard,
+                chunk.type,
+                chunk.sequence));
+        }
+    }
+    return result;
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+SnapshotContainerWriter::SnapshotContainerWriter(
+    std::filesystem::path dir, uint64_t const version, size_t const chunk_size,
+    ChunkCodec const codec)
+    : dir_{std::move(dir)}
+    , version_{version}
+    , chunk_size_{chunk_size}
+    , codec_{codec}
+{
+    MONAD_ASSERT(chunk_size_ > 0);
+    std::filesystem::create_directories(dir_);
+    std::filesystem::remove(dir_ / "index");
+    auto const path = dir_ / "chunks";
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    MONAD_ASSERT_PRINTF(
+        fd_ != -1, "open %s failed: %s", path.c_str(), strerror(errno));
+}
+
+SnapshotContainerWriter::~SnapshotContainerWriter()
+{
+    close(fd_);
+}
+
+void SnapshotContainerWriter::write_chunk(
+    uint64_t const shard, uint32_t const type, uint32_t const sequence,
+    byte_string_view const data)
+{
+    byte_string compressed;
+    ChunkCodec codec = ChunkCodec::None;
+    if (codec_ == ChunkCodec::Brotli) {
+        size_t size = BrotliEncoderMaxCompressedSize(data.size());
+        compressed.resize(size);
+        if (BrotliEncoderCompress(
+                BROTLI_QUALITY,
+                BROTLI_DEFAULT_WINDOW,
+                BROTLI_MODE_GENERIC,
+                data.size(),
+                data.data(),
+                &size,
+                compressed.data()) == BROTLI_TRUE &&
+            size < data.size()) {
+            compressed.resize(size);
+            codec = ChunkCodec::Brotli;
+        }
+    }
+    byte_string_view const stored =
+        codec == ChunkCodec::None ? data : byte_string_view{compressed};
+
+    uint64_t offset;
+    {
+        std::lock_guard const lock{mutex_};
+        offset = end_offset_;
+        end_offset_ += stored.size();
+    }
+    size_t done = 0;
+    while (done < stored.size()) {
+        ssize_t const r = pwrite(
+            fd_,
+            stored.data() + done,
+            stored.size() - done,
+            static_cast<off_t>(offset + done));
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+        MONAD_ASSERT_PRINTF(
+            r > 0, "write %s failed: %s", dir_.c_str(), strerror(errno));
+        done += static_cast<size_t>(r);
+    }
+
+    std::lock_guard const lock{mutex_};
+    chunks_.emplace_back(SnapshotChunk{
+        .shard = shard,
+        .type = type,
+        .sequence = sequence,
+        .offset = offset,
+        .stored_size = stored.size(),
+        .size = data.size(),
+        .codec = codec,
+        .checksum = blake3(stored)});
+}
+
+void SnapshotContainerWriter::append(
+    uint64_t const shard, uint32_t const type, byte_string_view data)
+{
+    while (!data.empty()) {
+        uint32_t sequence;
+        byte_string full;
+        {
+            std::lock_guard const lock{mutex_};
+            auto &[next_sequence, buf] = pending_[{shard, type}];
+            size_t const n = std::min(chunk_size_ - buf.size(), data.size());
+            buf += data.substr(0, n);
+            data.remove_prefix(n);
+            if (buf.size() < chunk_size_) {
+                continue;
+            }
+            sequence = next_sequence++;
+            full = std::exchange(buf, {});
+        }
+        write_chunk(shard, type, sequence, full);
+    }
+}
+
+void SnapshotContainerWriter::finish()
+{
+    for (auto &[key, pending] : pending_) {
+        auto &[sequence, buf] = pending;
+        if (!buf.empty()) {
+            write_chunk(key.first, key.second, sequence++, buf);
+            buf.clear();
+        }
+    }
+    MONAD_ASSERT_PRINTF(
+        fsync(fd_) == 0, "fsync %s failed: %s", dir_.c_str(), strerror(errno));
+
+    std::ranges::sort(chunks_, {}, [](SnapshotChunk const &c) {
+        return std::tuple{c.shard, c.type, c.sequence};
+    });
+    auto const path = dir_ / "index";
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        MONAD_ASSERT_PRINTF(os, "could not open %s", tmp_path.c_str());
+        write_pod(os, INDEX_MAGIC);
+        write_pod(os, FORMAT_VERSION);
+        write_pod(os, version_);
+        write_pod(os, static_cast<uint64_t>(chunk_size_));
+        write_pod(os, static_cast<uint64_t>(chunks_.size()));
+        for (SnapshotChunk const &chunk : chunks_) {
+            write_pod(os, chunk.shard);
+            write_pod(os, chunk.type);
+            write_pod(os, chunk.sequence);
+            write_pod(os, chunk.offset);
+            write_pod(os, chunk.stored_size);
+            write_pod(os, chunk.size);
+            write_pod(os, chunk.codec);
+            write_pod(os, chunk.checksum);
+        }
+        write_pod(os, INDEX_MAGIC);
+        MONAD_ASSERT_PRINTF(os.flush(), "could not write %s", path.c_str());
+    }
+    fsync_path(tmp_path);
+    std::filesystem::rename(tmp_path, path);
+    fsync_path(dir_);
+    LOG_INFO(
+        "Wrote snapshot container {} with {} chunks, {} bytes stored",
+        dir_,
+        chunks_.size(),
+        end_offset_);
+}
+
+bool is_snapshot_container(std::filesystem::path const &dir)
+{
+    return std::filesystem::is_regular_file(dir / "index") &&
+           std::filesystem::is_regular_file(dir / "chunks");
+}
+
+SnapshotContainerIndex read_snapshot_index(std::filesystem::path const &dir)
+{
+    auto const path = dir / "index";
+    std::ifstream is(path, std::ios::binary);
+    uint64_t magic;
+    uint64_t format;
+    uint64_t count;
+    SnapshotContainerIndex index;
+    if (!is || !read_pod(is, magic) || magic != INDEX_MAGIC ||
+        !read_pod(is, format)) {
+        throw std::runtime_error(
+            fmt::format("{} is not a snapshot index", path.string()));
+    }
+    if (format != FORMAT_VERSION) {
+        throw std::runtime_error(fmt::format(
+            "{} has format version {}, expected {}",
+            path.string(),
+            format,
+            FORMAT_VERSION));
+    }
+    if (!read_pod(is, index.version) || !read_pod(is, index.chunk_size) ||
+        !read_pod(is, count)) {
+        throw std::runtime_error(
+            fmt::format("truncated snapshot index {}", path.string()));
+    }
+    index.chunks.resize(count);
+    for (SnapshotChunk &chunk : index.chunks) {
+        if (!read_pod(is, chunk.shard) || !read_pod(is, chunk.type) ||
+            !read_pod(is, chunk.sequence) || !read_pod(is, chunk.offset) ||
+            !read_pod(is, chunk.stored_size) || !read_pod(is, chunk.size) ||
+            !read_pod(is, chunk.codec) || !read_pod(is, chunk.checksum)) {
+            throw std::runtime_error(
+                fmt::format("truncated snapshot index {}", path.string()));
+        }
+    }
+    if (!read_pod(is, magic) || magic != INDEX_MAGIC) {
+        throw std::runtime_error(
+            fmt::format("truncated snapshot index {}", path.string()));
+    }
+    return index;
+}
+
+uint64_t load_snapshot_container(
+    std::filesystem::path const &dir, unsigned const num_threads,
+    std::filesystem::path const &resume_log, bytes32_t const &target_id,
+    size_t const shards_per_persist,
+    std::function<void(SnapshotShard const &)> const &insert,
+    std::function<void()> const &persist)
+{
+    SnapshotContainerIndex const index = read_snapshot_index(dir);
+    std::map<uint64_t, std::vector<SnapshotChunk>> shards;
+    for (SnapshotChunk const &chunk : index.chunks) {
+        shards[chunk.shard].push_back(chunk);
+    }
+
+    // Shards inserted since the last persist are not in the log, and are
+    // inserted again on resume, which only rewrites the same values
+    std::set<uint64_t> loaded;
+    std::ofstream log;
+    if (!resume_log.empty()) {
+        bytes32_t const container_id = index_id(dir);
+        loaded = read_resume_log(resume_log, container_id, target_id);
+        if (!loaded.empty()) {
+            LOG_INFO(
+                "Resuming load of {}: {} of {} shards already loaded",
+                dir,
+                loaded.size(),
+                shards.size());
+            log.open(resume_log, std::ios::binary | std::ios::app);
+        }
+        else {
+            log.open(resume_log, std::ios::binary | std::ios::trunc);
+            write_pod(log, RESUME_MAGIC);
+            write_pod(log, container_id);
+            write_pod(log, target_id);
+        }
+        MONAD_ASSERT_PRINTF(
+            log.flush(), "could not write %s", resume_log.c_str());
+        fsync_path(resume_log);
+        fsync_parent(resume_log);
+    }
+
+    std::vector<uint64_t> unpersisted;
+    auto const persist_inserted = [&] {
+        if (unpersisted.empty()) {
+            return;
+        }
+        persist();
+        if (log.is_open()) {
+            for (uint64_t const shard : unpersisted) {
+                write_pod(log, shard);
+            }
+            MONAD_ASSERT_PRINTF(
+                log.flush(), "could not write %s", resume_log.c_str());
+            fsync_path(resume_log);
+        }
+        unpersisted.clear();
+    };
+
+    auto const chunks_path = dir / "chunks";
+    int const fd = open(chunks_path.c_str(), O_RDONLY | O_CLOEXEC);
+    MONAD_ASSERT_PRINTF(
+        fd != -1, "open %s failed: %s", chunks_path.c_str(), strerror(errno));
+
+    uint64_t inserted = 0;
+    {
+        std::deque<std::future<SnapshotShard>> in_flight;
+        auto next = shards.begin();
+        auto const fill = [&] {
+            while (in_flight.size() < std::max(num_threads, 1u) &&
+                   next != shards.end()) {
+                auto const &[shard, chunks] = *next++;
+                if (loaded.contains(shard)) {
+                    continue;
+                }
+                in_flight.emplace_back(std::async(
+                    std::launch::async,
+                    [fd, &chunks_path, shard, &chunks] {
+                        return read_shard(fd, chunks_path, shard, chunks);
+                    }));
+            }
+        };
+        for (fill(); !in_flight.empty(); fill()) {
+            SnapshotShard const shard = in_flight.front().get();
+            in_flight.pop_front();
+            insert(shard);
+            unpersisted.push_back(shard.shard);
+            if (unpersisted.size() >=
+                std::max(shards_per_persist, size_t{1})) {
+                persist_inserted();
+            }
+            ++inserted;
+        }
+    }
+    close(fd);
+    persist_inserted();
+    return inserted;
+}
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,142 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Snapshot container layout, version 1. A container is a directory holding
+///
+///   chunks  - chunk payloads, back to back, in no particular order
+///   index   - a header, one SnapshotChunk per chunk, and a trailer
+///
+/// The loader never writes into the container, which may be read-only or
+/// shared by loads into several dbs.
+///
+/// Every stream the dump produces, one per (shard, record type), is cut into
+/// chunks of at most `chunk_size` bytes before compression. Shards are the
+/// key-range partitions the snapshot dump walks the trie in, so a chunk's
+/// shard tells which subtrie its records belong to.
+enum class ChunkCodec : uint8_t
+{
+    None = 0,
+    Brotli = 1,
+};
+
+struct SnapshotChunk
+{
+    uint64_t shard;
+    uint32_t type; ///< monad_snapshot_type of the records
+    uint32_t sequence; ///< position in the (shard, type) stream
+    uint64_t offset; ///< into the chunks file
+    uint64_t stored_size; ///< after compression
+    uint64_t size; ///< before compression
+    ChunkCodec codec;
+    bytes32_t checksum; ///< blake3 of the stored bytes
+};
+
+struct SnapshotContainerIndex
+{
+    uint64_t version;
+    uint64_t chunk_size;
+    std::vector<SnapshotChunk> chunks;
+};
+
+/// Receives the record streams of a snapshot dump from any number of threads
+/// and writes them out as a container. Chunks are compressed, hashed and
+/// written by the thread that fills them; only the bookkeeping is serialized.
+class SnapshotContainerWriter
+{
+    std::filesystem::path const dir_;
+    uint64_t const version_;
+    size_t const chunk_size_;
+    ChunkCodec const codec_;
+    int fd_;
+
+    std::mutex mutex_;
+    uint64_t end_offset_{0};
+    std::map<std::pair<uint64_t, uint32_t>, std::pair<uint32_t, byte_string>>
+        pending_;
+    std::vector<SnapshotChunk> chunks_;
+
+    void write_chunk(
+        uint64_t shard, uint32_t type, uint32_t sequence, byte_string_view);
+
+public:
+    SnapshotContainerWriter(
+        std::filesystem::path dir, uint64_t version, size_t chunk_size,
+        ChunkCodec);
+    ~SnapshotContainerWriter();
+
+    SnapshotContainerWriter(SnapshotContainerWriter const &) = delete;
+    SnapshotContainerWriter &
+    operator=(SnapshotContainerWriter const &) = delete;
+
+    void append(uint64_t shard, uint32_t type, byte_string_view);
+
+    /// Writes out the partially filled chunks and then the index. The
+    /// container is not loadable until this returns.
+    void finish();
+};
+
+bool is_snapshot_container(std::filesystem::path const &dir);
+
+/// Throws if the index is missing, truncated or of another format version
+SnapshotContainerIndex
+read_snapshot_index(std::filesystem::path const &dir);
+
+/// The record streams of one shard, indexed by record type
+struct SnapshotShard
+{
+    uint64_t shard;
+    std::vector<byte_string> streams;
+};
+
+/// Loads a container shard by shard. Up to `num_threads` shards are read,
+/// checksummed and decompressed at once; `insert` is called on the calling
+/// thread with each in shard order. After every `shards_per_persist` shards,
+/// and after the last one, `persist` is called to make the inserted shards
+/// durable.
+///
+/// With a `resume_log`, which belongs with the target db rather than the
+/// container, shards are recorded in it once `persist` returns, and shards
+/// it already records are skipped. The log is keyed by the container's
+/// index and by `target_id`, an identity of the target db chosen by the
+/// caller; a log of another container or target is started afresh.
+///
+/// Throws on a checksum mismatch. Returns the number of shards inserted by
+/// this call.
+uint64_t load_snapshot_container(
+    std::filesystem::path const &dir, unsigned num_threads,
+    std::filesystem::path const &resume_log, bytes32_t const &target_id,
+    size_t shards_per_persist,
+    std::function<void(SnapshotShard const &)> const &insert,
+    std::function<void()> const &persist);
+
+MONAD_NAMESPACE_END
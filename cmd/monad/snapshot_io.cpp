@@ -0,0 +1,261 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "snapshot_io.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/config.hpp>
+
+#include <quill/Quill.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MONAD_NAMESPACE_BEGIN
+
+ReadaheadStreambuf::ReadaheadStreambuf(
+    std::filesystem::path path, size_t const chunk_size)
+    : path_{std::move(path)}
+    , chunk_size_{chunk_size}
+    , fd_{open(path_.c_str(), O_RDONLY | O_CLOEXEC)}
+{
+    MONAD_ASSERT_PRINTF(
+        fd_ != -1, "open %s failed: %s", path_.c_str(), strerror(errno));
+    struct stat st;
+    MONAD_ASSERT_PRINTF(
+        fstat(fd_, &st) == 0 && S_ISREG(st.st_mode),
+        "missing or bad file %s",
+        path_.c_str());
+    size_ = static_cast<uint64_t>(st.st_size);
+    (void)posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    current_.resize(chunk_size_);
+    next_.resize(chunk_size_);
+    read_ahead();
+}
+
+ReadaheadStreambuf::~ReadaheadStreambuf()
+{
+    if (pending_.valid()) {
+        pending_.wait();
+    }
+    close(fd_);
+}
+
+void ReadaheadStreambuf::read_ahead()
+{
+    pending_ = std::async(
+        std::launch::async,
+        [this, data = next_.data(), offset = next_offset_] {
+            size_t const len = static_cast<size_t>(
+                std::min<uint64_t>(chunk_size_, size_ - offset));
+            size_t done = 0;
+            while (done < len) {
+                ssize_t const r = pread(
+                    fd_,
+                    data + done,
+                    len - done,
+                    static_cast<off_t>(offset + done));
+                if (r == -1 && errno == EINTR) {
+                    continue;
+                }
+                MONAD_ASSERT_PRINTF(
+                    r > 0,
+                    "read %s failed: %s",
+                    path_.c_str(),
+                    r == 0 ? "unexpected end of file" : strerror(errno));
+                done += static_cast<size_t>(r);
+            }
+            return len;
+        });
+    pending_offset_ = next_offset_;
+    next_offset_ += std::min<uint64_t>(chunk_size_, size_ - next_offset_);
+}
+
+ReadaheadStreambuf::int_type ReadaheadStreambuf::underflow()
+{
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    if (!pending_.valid()) {
+        return traits_type::eof();
+    }
+    size_t const n = pending_.get();
+    if (n == 0) {
+        return traits_type::eof();
+    }
+    std::swap(current_, next_);
+    chunk_offset_ = pending_offset_;
+    setg(current_.data(), current_.data(), current_.data() + n);
+    consumed_.fetch_add(n, std::memory_order_relaxed);
+    read_ahead();
+    return traits_type::to_int_type(*gptr());
+}
+
+ReadaheadStreambuf::pos_type ReadaheadStreambuf::seekoff(
+    off_type const off, std::ios_base::seekdir const dir,
+    std::ios_base::openmode const which)
+{
+    off_type base;
+    switch (dir) {
+    case std::ios_base::beg:
+        base = 0;
+        break;
+    case std::ios_base::cur:
+        base = static_cast<off_type>(chunk_offset_) + (gptr() - eback());
+        break;
+    case std::ios_base::end:
+        base = static_cast<off_type>(size_);
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+    return seekpos(pos_type(base + off), which);
+}
+
+ReadaheadStreambuf::pos_type ReadaheadStreambuf::seekpos(
+    pos_type const pos, std::ios_base::openmode const which)
+{
+    off_type const target = pos;
+    if (!(which & std::ios_base::in) || target < 0 ||
+        static_cast<uint64_t>(target) > size_) {
+        return pos_type(off_type(-1));
+    }
+    auto const offset = static_cast<uint64_t>(target);
+    if (offset >= chunk_offset_ &&
+        offset - chunk_offset_ <= static_cast<uint64_t>(egptr() - eback())) {
+        setg(eback(), eback() + (offset - chunk_offset_), egptr());
+        return pos;
+    }
+    // The read in flight fills next_, so it has to land before the
+    // read-ahead can restart from the new position
+    if (pending_.valid()) {
+        (void)pending_.get();
+    }
+    setg(nullptr, nullptr, nullptr);
+    chunk_offset_ = offset;
+    next_offset_ = offset;
+    read_ahead();
+    return pos;
+}
+
+RateLimiter::RateLimiter(
+    uint64_t const bytes_per_second, std::chrono::milliseconds const burst)
+    : bytes_per_second_{bytes_per_second}
+    , burst_bytes_{
+          static_cast<double>(bytes_per_second) *
+          std::chrono::duration<double>{burst}.count()}
+    , tokens_{burst_bytes_}
+    , refilled_{std::chrono::steady_clock::now()}
+{
+}
+
+void RateLimiter::acquire(uint64_t const bytes)
+{
+    total_.fetch_add(bytes, std::memory_order_relaxed);
+    if (bytes_per_second_ == 0) {
+        return;
+    }
+    auto const rate = static_cast<double>(bytes_per_second_);
+    std::chrono::duration<double> debt{0};
+    {
+        std::lock_guard const lock{mutex_};
+        auto const now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> const idle = now - refilled_;
+        refilled_ = now;
+        // A write larger than the burst still goes through, the bucket just
+        // goes into debt that this and later callers sleep off
+        tokens_ = std::min(burst_bytes_, tokens_ + idle.count() * rate) -
+                  static_cast<double>(bytes);
+        if (tokens_ < 0) {
+            debt = std::chrono::duration<double>{-tokens_ / rate};
+        }
+    }
+    std::this_thread::sleep_for(debt);
+}
+
+SnapshotProgress::SnapshotProgress(
+    std::string label, std::function<uint64_t()> bytes_done,
+    uint64_t const total_bytes, std::chrono::seconds const interval)
+    : label_{std::move(label)}
+    , bytes_done_{std::move(bytes_done)}
+    , total_bytes_{total_bytes}
+    , begin_{std::chrono::steady_clock::now()}
+    , thread_{[this, interval](std::stop_token const token) {
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        std::unique_lock lock{mutex};
+        while (!token.stop_requested()) {
+            cv.wait_for(lock, token, interval, [] { return false; });
+            if (token.stop_requested()) {
+                break;
+            }
+            log();
+        }
+    }}
+{
+}
+
+SnapshotProgress::~SnapshotProgress()
+{
+    thread_.request_stop();
+    thread_.join();
+    log();
+}
+
+void SnapshotProgress::log() const
+{
+    uint64_t const done = bytes_done_();
+    auto const elapsed =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - begin_);
+    double const mb = static_cast<double>(done) / (1 << 20);
+    double const seconds =
+        static_cast<double>(std::max<int64_t>(1, elapsed.count())) / 1000.0;
+    double const mbps = mb / seconds;
+    if (total_bytes_ == 0) {
+        LOG_INFO(
+            "{}: {:.0f} MB in {}, {:.1f} MB/s", label_, mb, elapsed, mbps);
+        return;
+    }
+    double const pct = 100.0 * static_cast<double>(done) /
+                       static_cast<double>(total_bytes_);
+    LOG_INFO(
+        "{}: {:.0f} of {:.0f} MB ({:.1f}%) in {}, {:.1f} MB/s",
+        label_,
+        mb,
+        static_cast<double>(total_bytes_) / (1 << 20),
+        pct,
+        elapsed,
+        mbps);
+}
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,134 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <category/core/config.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <ios>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Read-only stream buffer over a snapshot file. The file is read in large
+/// chunks with pread, and the chunk after the one being parsed is read on a
+/// background thread, so the parser rarely waits on the disk. Seeking within
+/// the current chunk is free; seeking elsewhere drops the read-ahead and
+/// restarts it at the new position.
+class ReadaheadStreambuf : public std::streambuf
+{
+    std::filesystem::path const path_;
+    size_t const chunk_size_;
+    int fd_;
+    uint64_t size_;
+    uint64_t next_offset_{0};
+    uint64_t pending_offset_{0}; ///< file offset of the read in flight
+    uint64_t chunk_offset_{0}; ///< file offset of eback()
+    std::vector<char> current_;
+    std::vector<char> next_;
+    std::future<size_t> pending_;
+    std::atomic<uint64_t> consumed_{0};
+
+    void read_ahead();
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(
+        off_type, std::ios_base::seekdir, std::ios_base::openmode) override;
+    pos_type seekpos(pos_type, std::ios_base::openmode) override;
+
+public:
+    explicit ReadaheadStreambuf(
+        std::filesystem::path, size_t chunk_size = 64UL << 20);
+    ~ReadaheadStreambuf() override;
+
+    ReadaheadStreambuf(ReadaheadStreambuf const &) = delete;
+    ReadaheadStreambuf &operator=(ReadaheadStreambuf const &) = delete;
+
+    uint64_t size() const
+    {
+        return size_;
+    }
+
+    /// Bytes handed to the parser so far; safe to call from any thread
+    uint64_t consumed() const
+    {
+        return consumed_.load(std::memory_order_relaxed);
+    }
+};
+
+/// Paces a stream of reads or writes from any number of threads to at most
+/// `bytes_per_second` with a token bucket; zero means unlimited. Idle time
+/// earns at most `burst` worth of bytes, so a slow period is not followed by
+/// an unbounded burst.
+class RateLimiter
+{
+    uint64_t const bytes_per_second_;
+    double const burst_bytes_;
+    std::mutex mutex_;
+    double tokens_;
+    std::chrono::steady_clock::time_point refilled_;
+    std::atomic<uint64_t> total_{0};
+
+public:
+    explicit RateLimiter(
+        uint64_t bytes_per_second,
+        std::chrono::milliseconds burst = std::chrono::milliseconds{100});
+
+    /// Accounts `bytes` and sleeps until the bucket has paid for them
+    void acquire(uint64_t bytes);
+
+    uint64_t total() const
+    {
+        return total_.load(std::memory_order_relaxed);
+    }
+};
+
+/// Periodically logs how far a long snapshot load or dump has got and its
+/// throughput, and logs the totals once more when destroyed
+class SnapshotProgress
+{
+    std::string const label_;
+    std::function<uint64_t()> const bytes_done_;
+    uint64_t const total_bytes_;
+    std::chrono::steady_clock::time_point const begin_;
+    std::jthread thread_;
+
+    void log() const;
+
+public:
+    SnapshotProgress(
+        std::string label, std::function<uint64_t()> bytes_done,
+        uint64_t total_bytes,
+        std::chrono::seconds interval = std::chrono::seconds{10});
+    ~SnapshotProgress();
+
+    SnapshotProgress(SnapshotProgress const &) = delete;
+    SnapshotProgress &operator=(SnapshotProgress const &) = delete;
+};
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,196 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "state_diff.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/account.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+#include <category/execution/ethereum/core/block.hpp>
+#include <category/execution/ethereum/core/fmt/bytes_fmt.hpp>
+#include <category/execution/ethereum/db/block_db.hpp>
+#include <category/execution/ethereum/db/trie_db.hpp>
+#include <category/execution/ethereum/state2/state_deltas.hpp>
+#include <category/vm/code.hpp>
+
+#include <ankerl/unordered_dense.h>
+#include <evmc/hex.hpp>
+#include <intx/intx.hpp>
+#include <nlohmann/json.hpp>
+#include <quill/Quill.h>
+
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Everything a diff says about one account, merged across part files
+struct AccountChange
+{
+    std::optional<Account> account; ///< new fields, if they changed
+    bool deleted{false};
+    std::vector<std::pair<bytes32_t, bytes32_t>> storage;
+};
+
+template <class T>
+T parse_hex(nlohmann::json const &value)
+{
+    auto const res = evmc::from_hex<T>(value.get<std::string>());
+    if (!res.has_value()) {
+        throw std::runtime_error(
+            "bad hex value in state diff: " + value.dump());
+    }
+    return res.value();
+}
+
+std::pair<uint64_t, uint64_t> parse_range(std::filesystem::path const &dir)
+{
+    std::string const name = dir.filename().string();
+    uint64_t base = 0;
+    uint64_t target = 0;
+    char const *const begin = name.data();
+    char const *const end = begin + name.size();
+    auto const dash = name.find('-');
+    if (dash == std::string::npos ||
+        std::from_chars(begin, begin + dash, base).ec != std::errc{} ||
+        std::from_chars(begin + dash + 1, end, target).ec != std::errc{} ||
+        base >= target) {
+        throw std::runtime_error(
+            "state diff directory must be named <base>-<target>: " + name);
+    }
+    return {base, target};
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+uint64_t apply_state_diff(
+    TrieDb &db, BlockDb const &block_db, std::filesystem::path const &diff_dir)
+{
+    auto const [base, target] = parse_range(diff_dir);
+    if (db.get_block_number() != base) {
+        throw std::runtime_error(fmt::format(
+            "state diff {} applies to block {}, but the db is at block {}",
+            diff_dir.string(),
+            base,
+            db.get_block_number()));
+    }
+
+    ankerl::unordered_dense::segmented_map<Address, AccountChange> changes;
+    Code code;
+    uint64_t records = 0;
+    for (auto const &entry : std::filesystem::directory_iterator{diff_dir}) {
+        if (entry.path().extension() != ".ndjson") {
+            continue;
+        }
+        std::ifstream is(entry.path());
+        for (std::string line; std::getline(is, line); ++records) {
+            auto const record = nlohmann::json::parse(line);
+            if (!record.contains("address")) {
+                auto const bytes = evmc::from_hex(
+                    record.at("code").get<std::string>());
+                MONAD_ASSERT(bytes.has_value());
+                code.emplace(
+                    parse_hex<bytes32_t>(record.at("code_hash")),
+                    vm::make_shared_intercode(bytes.value()));
+                continue;
+            }
+            AccountChange &change =
+                changes[parse_hex<Address>(record.at("address"))];
+            if (record.contains("deleted")) {
+                change.deleted = true;
+            }
+            else if (record.contains("key")) {
+                change.storage.emplace_back(
+                    parse_hex<bytes32_t>(record.at("key")),
+                    parse_hex<bytes32_t>(record.at("value")));
+            }
+            else {
+                change.account = Account{
+                    .balance = intx::from_string<uint256_t>(
+                        record.at("balance").get<std::string>()),
+                    .code_hash = parse_hex<bytes32_t>(record.at("code_hash")),
+                    .nonce = record.at("nonce").get<uint64_t>()};
+            }
+        }
+    }
+
+    db.set_block_and_prefix(base);
+    StateDeltas deltas;
+    for (auto &[address, change] : changes) {
+        std::optional<Account> const before = db.read_account(address);
+        std::optional<Account> after = before;
+        if (change.deleted) {
+            after.reset();
+        }
+        else if (change.account.has_value()) {
+            after = change.account;
+            // Storage is keyed by incarnation; an account the diff only
+            // updates keeps its slots where they are
+            after->incarnation = before.has_value() ? before->incarnation
+                                                    : Incarnation{target, 0};
+        }
+        StateDeltas::accessor it;
+        MONAD_ASSERT(deltas.emplace(
+            it, address, StateDelta{.account = {before, after}}));
+        if (!after.has_value()) {
+            continue;
+        }
+        for (auto const &[key, value] : change.storage) {
+            bytes32_t const previous =
+                before.has_value()
+                    ? db.read_storage(address, before->incarnation, key)
+                    : bytes32_t{};
+            it->second.storage.emplace(key, StorageDelta{previous, value});
+        }
+    }
+
+    Block block;
+    MONAD_ASSERT_PRINTF(
+        block_db.get(target, block), "Could not load block %lu", target);
+    bytes32_t const block_id{target};
+    // State only; see the header for what this means for the stored block
+    db.commit(deltas, code, block_id, block.header);
+    db.finalize(target, block_id);
+
+    if (db.state_root() != block.header.state_root) {
+        throw std::runtime_error(fmt::format(
+            "state root {} after applying {} does not match block {} ({})",
+            db.state_root(),
+            diff_dir.string(),
+            target,
+            block.header.state_root));
+    }
+    LOG_INFO(
+        "Applied {} records of state diff {} for blocks {} to {}",
+        records,
+        diff_dir,
+        base,
+        target);
+    return target;
+}
+
+MONAD_NAMESPACE_END
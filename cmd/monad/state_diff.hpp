@@ -0,0 +1,39 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <category/core/config.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+MONAD_NAMESPACE_BEGIN
+
+class BlockDb;
+class TrieDb;
+
+/// Applies a diff written by dump_state_diff_ndjson to `db`, which must be at
+/// the diff's base block, as a commit of the diff's target block whose header
+/// is taken from `block_db`, so only ethereum chains are supported. The diff
+/// carries state only: the block is committed without transactions and
+/// receipts, which therefore do not match the roots of its header. Throws
+/// if the db is at another block or if the resulting state root does not
+/// match the header. Returns the new block.
+uint64_t apply_state_diff(
+    TrieDb &, BlockDb const &, std::filesystem::path const &diff_dir);
+
+MONAD_NAMESPACE_END
@@ -0,0 +1,500 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "state_dump.hpp"
+#include "snapshot_io.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/core/keccak.hpp>
+#include <category/execution/ethereum/core/account.hpp>
+#include <category/execution/ethereum/core/address.hpp>
+#include <category/execution/ethereum/db/util.hpp>
+#include <category/mpt/db.hpp>
+#include <category/mpt/nibbles_view.hpp>
+#include <category/mpt/node.hpp>
+#include <category/mpt/traverse.hpp>
+
+#include <ankerl/unordered_dense.h>
+#include <evmc/hex.hpp>
+#include <intx/intx.hpp>
+#include <quill/Quill.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+// Leaf depths, in nibbles, below the state or code prefix
+constexpr unsigned ACCOUNT_DEPTH = KECCAK256_SIZE * 2;
+constexpr unsigned STORAGE_DEPTH = KECCAK256_SIZE * 4;
+constexpr size_t OUTPUT_BUFFER_SIZE = 4UL << 20;
+
+enum class Pass : uint8_t
+{
+    State, ///< every account and slot
+    Code, ///< every code blob
+    StateChanged, ///< accounts and slots that are new or differ from the base
+    StateRemoved, ///< accounts and slots of the base that are gone
+};
+
+// A traversal of the subtrie below one top-level nibble of a trie
+struct Unit
+{
+    Pass pass;
+    unsigned char nibble;
+};
+
+std::string hex(byte_string_view const bytes)
+{
+    return "0x" + evmc::hex(bytes);
+}
+
+// Code hashes already looked up by the diff, shared by all workers
+struct SeenCode
+{
+    std::mutex mutex;
+    ankerl::unordered_dense::set<bytes32_t> hashes;
+};
+
+// Two nodes at the same key head identical subtries if they agree on their
+// own contents and on the hash of every child. Nodes without child hashes,
+// as in the code trie, never compare equal, which is why the diff finds new
+// code through the accounts that changed rather than by walking the code
+// trie.
+bool same_subtrie(mpt::Node const &a, mpt::Node const &b)
+{
+    if (a.mask != b.mask || a.path_nibble_view() != b.path_nibble_view() ||
+        a.has_value() != b.has_value() ||
+        (a.has_value() && a.value() != b.value())) {
+        return false;
+    }
+    for (unsigned i = 0; i < a.number_of_children(); ++i) {
+        byte_string_view const data = a.child_data_view(i);
+        if (data.empty() || data != b.child_data_view(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class DumpMachine final : public mpt::TraverseMachine
+{
+    std::ostream *os_;
+    std::atomic<uint64_t> *bytes_written_;
+    Unit unit_;
+    // For the diff passes, the db and version to compare against, and the
+    // version being walked
+    mpt::Db *other_db_;
+    uint64_t other_version_;
+    uint64_t version_;
+    SeenCode *seen_code_;
+    mpt::Nibbles path_{};
+    Address address_{};
+
+    unsigned char table() const
+    {
+        return unit_.pass == Pass::Code ? CODE_NIBBLE : STATE_NIBBLE;
+    }
+
+    void write(std::string const &line)
+    {
+        os_->write(line.data(), static_cast<std::streamsize>(line.size()));
+        bytes_written_->fetch_add(line.size(), std::memory_order_relaxed);
+    }
+
+    void write_account(Account const &account)
+    {
+        write(fmt::format(
+            "{{\"address\":\"{}\",\"balance\":\"0x{}\",\"nonce\":{},"
+            "\"code_hash\":\"{}\"}}\n",
+            hex({address_.bytes, sizeof(address_.bytes)}),
+            intx::hex(account.balance),
+            account.nonce,
+            hex({account.code_hash.bytes, sizeof(account.code_hash.bytes)})));
+    }
+
+    void write_storage(bytes32_t const &key, bytes32_t const &value)
+    {
+        write(fmt::format(
+            "{{\"address\":\"{}\",\"key\":\"{}\",\"value\":\"{}\"}}\n",
+            hex({address_.bytes, sizeof(address_.bytes)}),
+            hex({key.bytes, sizeof(key.bytes)}),
+            hex({value.bytes, sizeof(value.bytes)})));
+    }
+
+    void write_code(bytes32_t const &code_hash, byte_string_view const code)
+    {
+        write(fmt::format(
+            "{{\"code_hash\":\"{}\",\"code\":\"{}\"}}\n",
+            hex({code_hash.bytes, sizeof(code_hash.bytes)}),
+            hex(code)));
+    }
+
+    void write_code(mpt::NibblesView const path, byte_string_view const code)
+    {
+        bytes32_t code_hash;
+        for (unsigned i = 0; i < ACCOUNT_DEPTH; ++i) {
+            unsigned char const n = path.get(i);
+            code_hash.bytes[i / 2] |=
+                static_cast<uint8_t>(i % 2 == 0 ? n << 4 : n);
+        }
+        write_code(code_hash, code);
+    }
+
+    mpt::Node::SharedPtr
+    find_code(bytes32_t const &code_hash, uint64_t const version) const
+    {
+        auto const res = other_db_->find(
+            mpt::concat(
+                FINALIZED_NIBBLE,
+                CODE_NIBBLE,
+                mpt::NibblesView{byte_string_view{
+                    code_hash.bytes, sizeof(code_hash.bytes)}}),
+            version);
+        if (!res.has_value() || !res.value().is_valid() ||
+            !res.value().node->has_value()) {
+            return nullptr;
+        }
+        return res.value().node;
+    }
+
+    // Writes the code of a changed account unless the base already has it
+    void write_code_if_added(bytes32_t const &code_hash)
+    {
+        {
+            std::lock_guard const lock{seen_code_->mutex};
+            if (!seen_code_->hashes.insert(code_hash).second) {
+                return;
+            }
+        }
+        if (find_code(code_hash, other_version_) != nullptr) {
+            return;
+        }
+        // Accounts without code have no entry in either version
+        if (auto const node = find_code(code_hash, version_)) {
+            write_code(code_hash, node->value());
+        }
+    }
+
+    // Handles a node with a value at `path`, given the node at the same key
+    // in the other version if there is one. Returns false when the rest of
+    // the subtrie is of no interest.
+    bool handle_leaf(
+        mpt::NibblesView const path, mpt::Node const &node,
+        mpt::Node const *const other)
+    {
+        bool const in_other = other != nullptr && other->has_value();
+        bool const differs = !in_other || other->value() != node.value();
+        unsigned const depth = path.nibble_size();
+        if (unit_.pass == Pass::Code) {
+            if (depth == ACCOUNT_DEPTH) {
+                write_code(path, node.value());
+            }
+            return true;
+        }
+        byte_string_view encoded = node.value();
+        if (depth == ACCOUNT_DEPTH) {
+            auto const res = decode_account_db(encoded);
+            MONAD_ASSERT(res.has_value());
+            auto const &[address, account] = res.value();
+            address_ = address;
+            if (unit_.pass == Pass::StateRemoved) {
+                if (!in_other) {
+                    write(fmt::format(
+                        "{{\"address\":\"{}\",\"deleted\":true}}\n",
+                        hex({address.bytes, sizeof(address.bytes)})));
+                    // Its storage goes with it
+                    return false;
+                }
+            }
+            else if (unit_.pass == Pass::State || differs) {
+                write_account(account);
+                if (unit_.pass == Pass::StateChanged &&
+                    (!in_other || other_code_hash(*other) !=
+                                      account.code_hash)) {
+                    write_code_if_added(account.code_hash);
+                }
+            }
+        }
+        else if (depth == STORAGE_DEPTH) {
+            auto const res = decode_storage_db(encoded);
+            MONAD_ASSERT(res.has_value());
+            auto const &[key, value] = res.value();
+            if (unit_.pass == Pass::StateRemoved) {
+                if (!in_other) {
+                    write_storage(key, bytes32_t{});
+                }
+            }
+            else if (unit_.pass == Pass::State || differs) {
+                write_storage(key, value);
+            }
+        }
+        return true;
+    }
+
+    static bytes32_t other_code_hash(mpt::Node const &other)
+    {
+        byte_string_view encoded = other.value();
+        auto const res = decode_account_db(encoded);
+        MONAD_ASSERT(res.has_value());
+        return res.value().second.code_hash;
+    }
+
+public:
+    DumpMachine(
+        std::ostream &os, std::atomic<uint64_t> &bytes_written,
+        Unit const unit, mpt::Db *const other_db,
+        uint64_t const other_version, uint64_t const version,
+        SeenCode &seen_code)
+        : os_{&os}
+        , bytes_written_{&bytes_written}
+        , unit_{unit}
+        , other_db_{other_db}
+        , other_version_{other_version}
+        , version_{version}
+        , seen_code_{&seen_code}
+    {
+    }
+
+    bool down(unsigned char const branch, mpt::Node const &node) override
+    {
+        mpt::Nibbles path;
+        if (branch == mpt::INVALID_BRANCH) {
+            // The table root is shared by all units. Its path is not empty
+            // when every key of the table starts the same way, down to a
+            // single leaf, in which case only the unit of its first nibble
+            // takes it.
+            mpt::NibblesView const root_path = node.path_nibble_view();
+            if (root_path.nibble_size() == 0) {
+                MONAD_ASSERT(!node.has_value());
+                return true;
+            }
+            if (root_path.get(0) != unit_.nibble) {
+                return false;
+            }
+            path = root_path;
+        }
+        else if (path_.nibble_size() == 0 && branch != unit_.nibble) {
+            // Another unit owns this subtrie
+            return false;
+        }
+        else {
+            path = mpt::concat(
+                mpt::NibblesView{path_}, branch, node.path_nibble_view());
+        }
+
+        mpt::Node::SharedPtr other;
+        if (other_db_ != nullptr) {
+            auto const res = other_db_->find(
+                mpt::concat(FINALIZED_NIBBLE, table(), mpt::NibblesView{path}),
+                other_version_);
+            if (res.has_value() && res.value().is_valid()) {
+                other = res.value().node;
+                if (same_subtrie(*other, node)) {
+                    return false;
+                }
+            }
+        }
+        if (node.has_value() &&
+            !handle_leaf(mpt::NibblesView{path}, node, other.get())) {
+            return false;
+        }
+        path_ = std::move(path);
+        return true;
+    }
+
+    void up(unsigned char const branch, mpt::Node const &node) override
+    {
+        if (branch == mpt::INVALID_BRANCH) {
+            path_ = mpt::Nibbles{};
+            return;
+        }
+        mpt::NibblesView const path{path_};
+        unsigned const strip = 1 + node.path_nibble_view().nibble_size();
+        MONAD_ASSERT(path.nibble_size() >= strip);
+        path_ = path.substr(0, path.nibble_size() - strip);
+    }
+
+    std::unique_ptr<mpt::TraverseMachine> clone() const override
+    {
+        return std::make_unique<DumpMachine>(*this);
+    }
+};
+
+// Runs `units` over `nworkers` threads, each with its own read-only db (and a
+// second one to compare against for the diff passes) and output file
+void run_units(
+    mpt::ReadOnlyOnDiskDbConfig const &config,
+    std::filesystem::path const &out_dir, std::span<Unit const> const units,
+    uint64_t const version, std::optional<uint64_t> const base_version,
+    unsigned const num_workers, std::string const &label)
+{
+    std::filesystem::create_directories(out_dir);
+    unsigned const nworkers =
+        std::clamp(num_workers, 1u, static_cast<unsigned>(units.size()));
+    std::atomic<size_t> next_unit{0};
+    SeenCode seen_code;
+    std::vector<std::atomic<uint64_t>> bytes_written(nworkers);
+    SnapshotProgress const progress{
+        label,
+        [&bytes_written] {
+            uint64_t total = 0;
+            for (auto const &n : bytes_written) {
+                total += n.load(std::memory_order_relaxed);
+            }
+            return total;
+        },
+        0};
+
+    auto const work = [&](unsigned const worker) {
+        auto worker_config = config;
+        if (worker != 0) {
+            // Only one io ring gets the dedicated SQPOLL cpu
+            worker_config.sq_thread_cpu = std::nullopt;
+        }
+        mpt::AsyncIOContext io_ctx{worker_config};
+        mpt::Db db{io_ctx};
+        std::optional<mpt::AsyncIOContext> other_io_ctx;
+        std::optional<mpt::Db> other_db;
+        if (base_version.has_value()) {
+            worker_config.sq_thread_cpu = std::nullopt;
+            other_io_ctx.emplace(worker_config);
+            other_db.emplace(other_io_ctx.value());
+        }
+
+        std::vector<char> buffer(OUTPUT_BUFFER_SIZE);
+        std::ofstream os;
+        os.rdbuf()->pubsetbuf(buffer.data(), std::ssize(buffer));
+        auto const path = out_dir / fmt::format("part-{}.ndjson", worker);
+        os.open(path, std::ios::binary | std::ios::trunc);
+        MONAD_ASSERT_PRINTF(os, "could not open %s", path.c_str());
+
+        for (size_t i; (i = next_unit++) < units.size();) {
+            Unit const unit = units[i];
+            // The removal pass walks the base and looks things up in the
+            // newer version; every other diff pass is the other way round
+            uint64_t walk_version = version;
+            uint64_t other_version = base_version.value_or(version);
+            if (unit.pass == Pass::StateRemoved) {
+                std::swap(walk_version, other_version);
+            }
+            bool const is_code = unit.pass == Pass::Code;
+            auto const cursor = db.find(
+                mpt::concat(
+                    FINALIZED_NIBBLE, is_code ? CODE_NIBBLE : STATE_NIBBLE),
+                walk_version);
+            if (!cursor.has_value() || !cursor.value().is_valid()) {
+                continue;
+            }
+            DumpMachine machine{
+                os,
+                bytes_written[worker],
+                unit,
+                other_db.has_value() ? &other_db.value() : nullptr,
+                other_version,
+                walk_version,
+                seen_code};
+            MONAD_ASSERT_PRINTF(
+                db.traverse(cursor.value(), machine, walk_version),
+                "version %lu was pruned from the db during the dump",
+                walk_version);
+        }
+        MONAD_ASSERT_PRINTF(os.flush(), "could not write %s", path.c_str());
+    };
+
+    std::vector<std::jthread> workers;
+    for (unsigned w = 0; w < nworkers; ++w) {
+        workers.emplace_back(work, w);
+    }
+}
+
+std::vector<Unit> make_units(std::initializer_list<Pass> const passes)
+{
+    std::vector<Unit> units;
+    for (Pass const pass : passes) {
+        for (unsigned char nibble = 0; nibble < 16; ++nibble) {
+            units.emplace_back(Unit{.pass = pass, .nibble = nibble});
+        }
+    }
+    return units;
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
+uint64_t dump_state_ndjson(
+    mpt::ReadOnlyOnDiskDbConfig const &config,
+    std::filesystem::path const &dir, unsigned const num_workers)
+{
+    uint64_t const block_number = [&] {
+        mpt::AsyncIOContext io_ctx{config};
+        mpt::Db db{io_ctx};
+        return db.get_latest_finalized_version();
+    }();
+    MONAD_ASSERT(block_number != mpt::INVALID_BLOCK_NUM);
+    auto const out_dir = dir / std::to_string(block_number);
+    run_units(
+        config,
+        out_dir,
+        make_units({Pass::State, Pass::Code}),
+        block_number,
+        std::nullopt,
+        num_workers,
+        "Dumping state");
+    LOG_INFO("Dumped state of block {} to {}", block_number, out_dir);
+    return block_number;
+}
+
+void dump_state_diff_ndjson(
+    mpt::ReadOnlyOnDiskDbConfig const &config,
+    std::filesystem::path const &dir, uint64_t const base_version,
+    uint64_t const version, unsigned const num_workers)
+{
+    MONAD_ASSERT(base_version < version);
+    auto const out_dir = dir / fmt::format("{}-{}", base_version, version);
+    run_units(
+        config,
+        out_dir,
+        make_units({Pass::StateChanged, Pass::StateRemoved}),
+        version,
+        base_version,
+        num_workers,
+        "Dumping state diff");
+    LOG_INFO(
+        "Dumped state changes from block {} to {} to {}",
+        base_version,
+        version,
+        out_dir);
+}
+
+MONAD_NAMESPACE_END
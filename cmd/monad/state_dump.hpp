@@ -0,0 +1,53 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <category/core/config.hpp>
+#include <category/mpt/ondisk_db_config.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+MONAD_NAMESPACE_BEGIN
+
+/// Dumps the latest finalized state of the on-disk db as newline delimited
+/// JSON under `dir/<block number>/`, one `part-<n>.ndjson` per worker. Each
+/// worker opens its own read-only db and takes whole top-level nibbles of the
+/// state and code tries, writing records as it reaches them, so memory use
+/// does not grow with the size of the state. Returns the dumped block number.
+///
+/// Record shapes, one per line:
+///   {"address":..,"balance":..,"nonce":..,"code_hash":..}
+///   {"address":..,"key":..,"value":..}
+///   {"code_hash":..,"code":..}
+uint64_t dump_state_ndjson(
+    mpt::ReadOnlyOnDiskDbConfig const &, std::filesystem::path const &dir,
+    unsigned num_workers);
+
+/// Dumps what differs between finalized versions `base_version` and
+/// `version` under `dir/<base_version>-<version>/`, in the shapes above plus
+///   {"address":..,"deleted":true}
+/// Subtries whose children hash the same in both versions are skipped, so
+/// the work follows the size of the change rather than of the state. Slots
+/// present only in the base are written with a zero value. Code is written
+/// for the new or changed code hashes of written accounts that the base does
+/// not have, rather than by walking the code trie.
+void dump_state_diff_ndjson(
+    mpt::ReadOnlyOnDiskDbConfig const &, std::filesystem::path const &dir,
+    uint64_t base_version, uint64_t version, unsigned num_workers);
+
+MONAD_NAMESPACE_END
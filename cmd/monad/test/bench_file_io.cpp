@@ -0,0 +1,107 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Compares the ledger read path, one fstat and pread into a reused buffer
+// hashed chunk by chunk, with the istreambuf_iterator read it replaced
+
+#include "../file_io.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/blake3.hpp>
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
+
+#include <evmc/hex.hpp>
+#include <nanobench.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace monad;
+
+namespace
+{
+    byte_string
+    read_file_baseline(bytes32_t const &id, std::filesystem::path const &dir)
+    {
+        std::filesystem::path const path = dir / evmc::hex(id);
+        MONAD_ASSERT(
+            std::filesystem::exists(path) &&
+            std::filesystem::is_regular_file(path));
+        std::ifstream is(path);
+        MONAD_ASSERT(is);
+        byte_string const data{
+            std::istreambuf_iterator<char>(is),
+            std::istreambuf_iterator<char>()};
+        MONAD_ASSERT(to_bytes(blake3(data)) == id);
+        return data;
+    }
+
+    bytes32_t write_ledger_file(
+        std::filesystem::path const &dir, size_t const size,
+        std::mt19937_64 &rng)
+    {
+        byte_string data(size, 0);
+        for (auto &b : data) {
+            b = static_cast<uint8_t>(rng());
+        }
+        bytes32_t const id = to_bytes(blake3(data));
+        std::ofstream os(dir / evmc::hex(id), std::ios::binary);
+        os.write(reinterpret_cast<char const *>(data.data()), data.size());
+        return id;
+    }
+}
+
+int main()
+{
+    auto const dir = std::filesystem::temp_directory_path() /
+                     "monad_bench_file_io";
+    std::filesystem::create_directories(dir);
+    std::mt19937_64 rng{42};
+
+    // Roughly a header, a typical body and a full body
+    for (size_t const size : {size_t{1} << 10, size_t{256} << 10,
+                              size_t{4} << 20}) {
+        std::vector<bytes32_t> ids;
+        for (unsigned i = 0; i < 16; ++i) {
+            ids.push_back(write_ledger_file(dir, size, rng));
+        }
+        ankerl::nanobench::Bench bench;
+        bench.title("ledger file read, " + std::to_string(size) + " bytes")
+            .unit("byte")
+            .batch(size)
+            .relative(true)
+            .minEpochIterations(16);
+        size_t i = 0;
+        bench.run("istreambuf_iterator, blake3 after", [&] {
+            auto const data = read_file_baseline(ids[i++ % ids.size()], dir);
+            ankerl::nanobench::doNotOptimizeAway(data);
+        });
+        byte_string buf;
+        bench.run("fstat+pread, chunked blake3", [&] {
+            auto const data = read_file(ids[i++ % ids.size()], dir, buf);
+            ankerl::nanobench::doNotOptimizeAway(data);
+        });
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Compares sender recovery batched into one pool job per run of
+// transactions, as the runloops do it, with the library's one job per
+// transaction
+
+#include "../sender_cache.hpp"
+
+#include <category/core/fiber/priority_pool.hpp>
+#include <category/core/int.hpp>
+#include <category/execution/ethereum/core/transaction.hpp>
+#include <category/execution/ethereum/execute_block.hpp>
+
+#include <nanobench.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace monad;
+
+namespace
+{
+    // Recovery does the same work whether or not the signature was made by
+    // a real key, so random (r, s) pairs are good enough to time it
+    std::vector<Transaction> make_transactions(size_t const n)
+    {
+        std::mt19937_64 rng{n};
+        std::vector<Transaction> transactions(n);
+        for (size_t i = 0; i < n; ++i) {
+            Transaction &tx = transactions[i];
+            tx.sc.r = uint256_t{rng(), rng(), rng(), rng() >> 2};
+            tx.sc.s = uint256_t{rng(), rng(), 0, 0};
+            tx.sc.chain_id = 1;
+            tx.nonce = i;
+            tx.gas_limit = 21'000;
+        }
+        return transactions;
+    }
+}
+
+int main()
+{
+    unsigned const nthreads = std::max(1u, std::thread::hardware_concurrency());
+    fiber::PriorityPool priority_pool{nthreads, nthreads * 16};
+
+    for (size_t const ntxs : {size_t{100}, size_t{1'000}, size_t{5'000}}) {
+        std::vector<Transaction> const transactions = make_transactions(ntxs);
+        ankerl::nanobench::Bench bench;
+        bench.title("sender recovery, " + std::to_string(ntxs) + " txs")
+            .unit("tx")
+            .batch(ntxs)
+            .relative(true)
+            .minEpochIterations(4);
+        bench.run("one pool job per transaction", [&] {
+            auto const senders = recover_senders(transactions, priority_pool);
+            ankerl::nanobench::doNotOptimizeAway(senders);
+        });
+        bench.run("batched jobs, set built as batches finish", [&] {
+            // A fresh cache, so every signature is recovered
+            SenderCache cache{1};
+            auto const recovered = recover_senders_and_authorities(
+                transactions, priority_pool, cache);
+            ankerl::nanobench::doNotOptimizeAway(recovered);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the discovery overhead of tailing the consensus WAL at high block
+// rates: the cost of picking up each newly appended entry, and of
+// positioning the reader on restart. The header walk is represented by the
+// head symlink reads it does on every iteration before touching any header
+// or the db, which makes it a lower bound of what it costs.
+
+#include "../file_io.hpp"
+#include "../wal_reader.hpp"
+
+#include <category/core/assert.h>
+#include <category/core/bytes.hpp>
+#include <category/execution/monad/chain/monad_devnet.hpp>
+
+#include <evmc/hex.hpp>
+#include <nanobench.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace monad;
+
+namespace
+{
+    WalEntry random_entry(std::mt19937_64 &rng)
+    {
+        WalEntry entry{
+            .action = rng() % 2 ? WalAction::PROPOSE : WalAction::FINALIZE,
+            .id = {}};
+        for (auto &b : entry.id.bytes) {
+            b = static_cast<uint8_t>(rng());
+        }
+        return entry;
+    }
+
+    void append_entries(int const fd, std::vector<WalEntry> const &entries)
+    {
+        size_t const size = entries.size() * sizeof(WalEntry);
+        MONAD_ASSERT(
+            write(fd, entries.data(), size) == static_cast<ssize_t>(size));
+    }
+
+    // Head symlinks only need to resolve to a hex name, not to a header
+    void make_head(
+        std::filesystem::path const &header_dir, std::string const &name,
+        std::mt19937_64 &rng)
+    {
+        bytes32_t id;
+        for (auto &b : id.bytes) {
+            b = static_cast<uint8_t>(rng());
+        }
+        std::filesystem::create_symlink(
+            header_dir / evmc::hex(id), header_dir / name);
+    }
+}
+
+int main()
+{
+    auto const dir = std::filesystem::temp_directory_path() /
+                     "monad_bench_wal_discovery";
+    std::filesystem::remove_all(dir);
+    auto const header_dir = dir / "headers";
+    std::filesystem::create_directories(header_dir);
+    std::mt19937_64 rng{42};
+    MonadDevnet chain;
+
+    auto const proposed_head = header_dir / "proposed_head";
+    auto const finalized_head = header_dir / "finalized_head";
+    make_head(header_dir, "proposed_head", rng);
+    make_head(header_dir, "finalized_head", rng);
+
+    int const fd =
+        open((dir / "wal").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    MONAD_ASSERT(fd != -1);
+
+    // A WAL with history behind the tail, as after a long run
+    constexpr size_t HISTORY = 1 << 20;
+    {
+        std::vector<WalEntry> history;
+        for (size_t i = 0; i < HISTORY; ++i) {
+            history.push_back(random_entry(rng));
+        }
+        append_entries(fd, history);
+    }
+
+    {
+        WalReader reader{chain, dir};
+        (void)reader.next_entries(HISTORY);
+        std::vector<WalEntry> const one{random_entry(rng)};
+
+        ankerl::nanobench::Bench bench;
+        bench.title("discovery per iteration, one new block")
+            .unit("iteration")
+            .relative(true)
+            .minEpochIterations(1024);
+        bench.run("read head symlinks (header walk)", [&] {
+            ankerl::nanobench::doNotOptimizeAway(
+                head_pointer_to_id(finalized_head));
+            ankerl::nanobench::doNotOptimizeAway(
+                head_pointer_to_id(proposed_head));
+        });
+        // Includes the append that consensus would do
+        bench.run("append and tail the WAL", [&] {
+            append_entries(fd, one);
+            auto const entries = reader.next_entries(256);
+            MONAD_ASSERT(entries.size() == 1);
+            ankerl::nanobench::doNotOptimizeAway(entries);
+        });
+    }
+
+    {
+        std::vector<WalEntry> batch;
+        for (size_t i = 0; i < 256; ++i) {
+            batch.push_back(random_entry(rng));
+        }
+        WalReader reader{chain, dir};
+        (void)reader.next_entries(SIZE_MAX);
+
+        ankerl::nanobench::Bench bench;
+        bench.title("discovery per block, 256 new blocks per iteration")
+            .unit("block")
+            .batch(batch.size())
+            .minEpochIterations(64);
+        bench.run("append and tail the WAL", [&] {
+            append_entries(fd, batch);
+            auto const entries = reader.next_entries(batch.size());
+            MONAD_ASSERT(entries.size() == batch.size());
+            ankerl::nanobench::doNotOptimizeAway(entries);
+        });
+    }
+
+    {
+        WalEntry const last = random_entry(rng);
+        append_entries(fd, {last});
+        auto const size = std::filesystem::file_size(dir / "wal");
+
+        ankerl::nanobench::Bench bench;
+        bench.title("restart, " + std::to_string(size / sizeof(WalEntry)) +
+                    " WAL entries")
+            .unit("restart")
+            .minEpochIterations(4);
+        bench.run("map, index and rewind to the tail", [&] {
+            WalReader reader{chain, dir};
+            MONAD_ASSERT(reader.rewind_to(last));
+        });
+    }
+
+    (void)close(fd);
+    std::filesystem::remove_all(dir);
+    return 0;
+}
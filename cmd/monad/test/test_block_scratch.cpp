@@ -0,0 +1,157 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../block_scratch.hpp"
+
+#include <category/execution/ethereum/core/transaction.hpp>
+#include <category/execution/ethereum/trace/call_tracer.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace monad;
+
+namespace
+{
+    // Counts heap allocations made by this thread while a CountAllocations
+    // scope is alive
+    thread_local bool counting = false;
+    thread_local size_t allocations = 0;
+
+    struct CountAllocations
+    {
+        CountAllocations()
+        {
+            allocations = 0;
+            counting = true;
+        }
+
+        ~CountAllocations()
+        {
+            counting = false;
+        }
+
+        size_t count() const
+        {
+            return allocations;
+        }
+    };
+
+    std::vector<void const *> call_tracer_ptrs(BlockScratch const &scratch)
+    {
+        std::vector<void const *> ptrs;
+        for (auto const &tracer : scratch.call_tracers) {
+            ptrs.push_back(tracer.get());
+        }
+        return ptrs;
+    }
+}
+
+void *operator new(size_t const size)
+{
+    if (counting) {
+        ++allocations;
+    }
+    if (void *const p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *const p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *const p, size_t) noexcept
+{
+    std::free(p);
+}
+
+TEST(BlockScratchPool, recycled_block_does_not_allocate)
+{
+    std::vector<Transaction> const transactions(64);
+    BlockScratchPool pool;
+
+    // The first block of a given size populates the pool
+    auto scratch = pool.acquire(transactions, false);
+    auto const *const senders = scratch.senders.data();
+    auto const tracers = call_tracer_ptrs(scratch);
+    pool.release(std::move(scratch));
+
+    size_t count;
+    {
+        CountAllocations const counter;
+        scratch = pool.acquire(transactions, false);
+        pool.release(std::move(scratch));
+        scratch = pool.acquire(transactions, false);
+        count = counter.count();
+    }
+    EXPECT_EQ(count, 0u);
+    ASSERT_EQ(scratch.senders.size(), transactions.size());
+    ASSERT_EQ(scratch.call_tracers.size(), transactions.size());
+    ASSERT_EQ(scratch.state_tracers.size(), transactions.size());
+    EXPECT_EQ(scratch.senders.data(), senders);
+
+    // Tracers come back in reverse, but they are the same objects
+    auto recycled = call_tracer_ptrs(scratch);
+    std::ranges::sort(recycled);
+    auto expected = tracers;
+    std::ranges::sort(expected);
+    EXPECT_EQ(recycled, expected);
+    for (auto const &tracer : scratch.call_tracers) {
+        EXPECT_NE(dynamic_cast<NoopCallTracer *>(tracer.get()), nullptr);
+    }
+    pool.release(std::move(scratch));
+}
+
+TEST(BlockScratchPool, smaller_block_does_not_allocate)
+{
+    std::vector<Transaction> const large(64);
+    std::vector<Transaction> const small(8);
+    BlockScratchPool pool;
+
+    pool.release(pool.acquire(large, false));
+
+    size_t count;
+    {
+        CountAllocations const counter;
+        auto scratch = pool.acquire(small, false);
+        pool.release(std::move(scratch));
+        count = counter.count();
+    }
+    EXPECT_EQ(count, 0u);
+}
+
+TEST(BlockScratchPool, tracing_call_tracers_are_not_recycled)
+{
+    std::vector<Transaction> const transactions(4);
+    BlockScratchPool pool;
+
+    pool.release(pool.acquire(transactions, true));
+
+    auto scratch = pool.acquire(transactions, false);
+    ASSERT_EQ(scratch.call_tracers.size(), transactions.size());
+    for (auto const &tracer : scratch.call_tracers) {
+        EXPECT_NE(dynamic_cast<NoopCallTracer *>(tracer.get()), nullptr);
+    }
+    pool.release(std::move(scratch));
+}
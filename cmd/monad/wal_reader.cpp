@@ -13,135 +13,257 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+
+#include "wal_reader.hpp"
+#include "file_io.hpp"
+
 #include <category/core/assert.h>
-#include <category/core/blake3.hpp>
 #include <category/core/byte_string.hpp>
 #include <category/core/bytes.hpp>
-#include <category/execution/ethereum/core/fmt/bytes_fmt.hpp>
-#include <category/execution/ethereum/wal_reader.hpp>
-#include <category/execution/monad/core/rlp/monad_block_rlp.hpp>
 
-#include <evmc/hex.hpp>
+#include <quill/Quill.h>
 
-#include <sstream>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <variant>
 
-using std::ios;
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-MONAD_NAMESPACE_BEGIN
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
 
-namespace
+constexpr uint64_t POSITION_MAGIC = 0x31736f706c617764; // "dwalpos1"
+
+uint64_t entry_digest(WalEntry const &entry)
 {
+    uint64_t digest;
+    std::memcpy(&digest, entry.id.bytes, sizeof(digest));
+    return digest ^ static_cast<uint64_t>(entry.action);
+}
 
-    constexpr auto WAL_ENTRY_SIZE =
-        static_cast<std::streamoff>(sizeof(WalEntry));
+bool same_entry(WalEntry const &a, WalEntry const &b)
+{
+    return a.action == b.action &&
+           std::bit_cast<bytes32_t>(a.id) == std::bit_cast<bytes32_t>(b.id);
+}
 
-    byte_string slurp_file(std::filesystem::path const &path)
-    {
-        MONAD_ASSERT(
-            std::filesystem::exists(path) &&
-            std::filesystem::is_regular_file(path));
-        std::ifstream is(path);
-        byte_string contents{
-            std::istreambuf_iterator<char>(is),
-            std::istreambuf_iterator<char>()};
-        MONAD_ASSERT(is);
-        return contents;
-    }
+WalReader::Result read_entry(
+    MonadChain const &chain, std::filesystem::path const &ledger_dir,
+    WalEntry const &entry, byte_string &header_buf, byte_string &body_buf)
+{
+    bytes32_t const id = std::bit_cast<bytes32_t>(entry.id);
+    ConsensusHeader header =
+        read_header(id, ledger_dir / "headers", chain, header_buf);
+    bytes32_t const body_id = std::visit(
+        [](auto const &h) { return h.block_body_id; }, header);
+    return WalReader::Result{
+        .action = entry.action,
+        .block_id = id,
+        .header = std::move(header),
+        .body = read_body(body_id, ledger_dir / "bodies", body_buf)};
 }
 
+MONAD_ANONYMOUS_NAMESPACE_END
+
+MONAD_NAMESPACE_BEGIN
+
 WalReader::WalReader(
     MonadChain const &chain, std::filesystem::path const &ledger_dir)
     : chain_{chain}
     , ledger_dir_{ledger_dir}
 {
-    cursor_.open(ledger_dir_ / "wal", std::ios::binary);
-    MONAD_ASSERT(cursor_);
+    auto const path = ledger_dir_ / "wal";
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    MONAD_ASSERT_PRINTF(
+        fd_ != -1, "open %s failed: %s", path.c_str(), strerror(errno));
+    refresh();
 }
 
-std::optional<WalReader::Result> WalReader::next()
+WalReader::~WalReader()
 {
-    WalEntry entry;
-    auto const pos = cursor_.tellg();
-    MONAD_ASSERT(pos != -1);
-    if (MONAD_LIKELY(
-            cursor_.read(reinterpret_cast<char *>(&entry), sizeof(WalEntry)))) {
-        auto const header_filename = fmt::format(
-            "{}.header", evmc::hex(to_byte_string_view(entry.id.bytes)));
-        auto const header_data = slurp_file(ledger_dir_ / header_filename);
-        byte_string_view header_view{header_data};
-        auto const checksum_header = to_bytes(blake3(header_view));
-        MONAD_ASSERT_PRINTF(
-            checksum_header == entry.id,
-            "Checksum failed for bft header %s",
-            header_filename.c_str());
-        auto const header_res =
-            rlp::decode_consensus_block_header(chain_, header_view);
-        MONAD_ASSERT_PRINTF(
-            !header_res.has_error(),
-            "Could not rlp decode file %s",
-            header_filename.c_str());
-
-        auto const body_filename =
-            fmt::format("{}.body", evmc::hex(header_res.value().block_body_id));
-        auto const body_data = slurp_file(ledger_dir_ / body_filename);
-        auto const checksum_body = to_bytes(blake3(body_data));
-        MONAD_ASSERT_PRINTF(
-            checksum_body == header_res.value().block_body_id,
-            "Checksum failed for bft block body %s",
-            body_filename.c_str());
-        byte_string_view body_view{body_data};
-        auto const body_res = rlp::decode_consensus_block_body(body_view);
-        MONAD_ASSERT_PRINTF(
-            !header_res.has_error(),
-            "Could not rlp decode file %s",
-            body_filename.c_str());
-
-        return Result{
-            .action = entry.action,
-            .header = std::move(header_res.value()),
-            .body = std::move(body_res.value())};
+    if (map_ != nullptr) {
+        munmap(const_cast<unsigned char *>(map_), map_size_);
+    }
+    close(fd_);
+}
+
+// Extends the mapping over whatever consensus appended since the last call
+// and indexes the new complete entries. A partially written trailing entry
+// is left for a later call.
+void WalReader::refresh()
+{
+    struct stat st;
+    MONAD_ASSERT_PRINTF(
+        fstat(fd_, &st) == 0, "fstat of wal failed: %s", strerror(errno));
+    auto const size = static_cast<size_t>(st.st_size);
+    MONAD_ASSERT_PRINTF(
+        size >= map_size_, "wal shrank from %zu to %zu", map_size_, size);
+    if (size == map_size_) {
+        return;
     }
-    else {
-        // execution got ahead
-        cursor_.clear();
-        cursor_.seekg(pos);
-        return {};
+
+    void *const map =
+        map_ == nullptr
+            ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0)
+            : mremap(
+                  const_cast<unsigned char *>(map_),
+                  map_size_,
+                  size,
+                  MREMAP_MAYMOVE);
+    MONAD_ASSERT_PRINTF(
+        map != MAP_FAILED, "mapping wal failed: %s", strerror(errno));
+    map_ = static_cast<unsigned char const *>(map);
+    map_size_ = size;
+    (void)madvise(map, size, MADV_SEQUENTIAL);
+
+    size_t const num_entries = size / sizeof(WalEntry);
+    index_.reserve(num_entries);
+    for (size_t i = num_entries_; i < num_entries; ++i) {
+        index_.insert_or_assign(entry_digest(entry_at(i)), i);
     }
+    num_entries_ = num_entries;
 }
 
-bool WalReader::rewind_to(WalEntry const &rewind_entry)
+WalEntry WalReader::entry_at(size_t const i) const
 {
-    cursor_.seekg(0, ios::end);
-    auto const size_on_start = cursor_.tellg();
-    MONAD_ASSERT(size_on_start != -1);
-    cursor_.seekg(0, ios::beg);
-
-    if (size_on_start >= WAL_ENTRY_SIZE) {
-        auto const pos =
-            (size_on_start / WAL_ENTRY_SIZE) * WAL_ENTRY_SIZE - WAL_ENTRY_SIZE;
-        cursor_.seekg(pos);
-        while (cursor_) {
-            WalEntry entry;
-            if (!cursor_.read(
-                    reinterpret_cast<char *>(&entry), sizeof(WalEntry))) {
-                MONAD_ASSERT(false);
-            }
+    MONAD_ASSERT((i + 1) * sizeof(WalEntry) <= map_size_);
+    WalEntry entry;
+    std::memcpy(&entry, map_ + i * sizeof(WalEntry), sizeof(WalEntry));
+    return entry;
+}
 
-            if (std::bit_cast<bytes32_t>(entry.id) ==
-                    std::bit_cast<bytes32_t>(rewind_entry.id) &&
-                entry.action == rewind_entry.action) {
-                cursor_.seekg(-WAL_ENTRY_SIZE, ios::cur);
+std::optional<WalReader::Result> WalReader::next()
+{
+    if (cursor_ == num_entries_) {
+        refresh();
+        if (cursor_ == num_entries_) {
+            // execution got ahead
+            return std::nullopt;
+        }
+    }
+    WalEntry const entry = entry_at(cursor_);
+    Result result =
+        read_entry(chain_, ledger_dir_, entry, header_buf_, body_buf_);
+    ++cursor_;
+    return result;
+}
+
+std::vector<WalReader::Result> WalReader::next_n(size_t const n)
+{
+    if (num_entries_ - cursor_ < n) {
+        refresh();
+    }
+    size_t const count = std::min(n, num_entries_ - cursor_);
+    std::vector<Result> results;
+    if (count == 0) {
+        return results;
+    }
+    if (batch_bufs_.size() < count) {
+        batch_bufs_.resize(count);
+    }
+
+    // The first entry is read on this thread; the rest are in flight
+    // meanwhile, each with its own pair of buffers
+    std::vector<std::future<Result>> pending;
+    pending.reserve(count - 1);
+    for (size_t i = 1; i < count; ++i) {
+        pending.emplace_back(std::async(
+            std::launch::async,
+            [this, entry = entry_at(cursor_ + i), &bufs = batch_bufs_[i]] {
+                return read_entry(
+                    chain_, ledger_dir_, entry, bufs.first, bufs.second);
+            }));
+    }
+    results.reserve(count);
+    results.emplace_back(read_entry(
+        chain_,
+        ledger_dir_,
+        entry_at(cursor_),
+        batch_bufs_[0].first,
+        batch_bufs_[0].second));
+    for (auto &f : pending) {
+        results.emplace_back(f.get());
+    }
+    cursor_ += count;
+    return results;
+}
+
+std::vector<WalEntry> WalReader::next_entries(size_t const n)
+{
+    if (num_entries_ - cursor_ < n) {
+        refresh();
+    }
+    size_t const count = std::min(n, num_entries_ - cursor_);
+    std::vector<WalEntry> entries;
+    entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        entries.emplace_back(entry_at(cursor_ + i));
+    }
+    cursor_ += count;
+    return entries;
+}
 
+bool WalReader::rewind_to(WalEntry const &rewind_entry)
+{
+    refresh();
+    auto const it = index_.find(entry_digest(rewind_entry));
+    if (it != index_.end()) {
+        if (same_entry(entry_at(it->second), rewind_entry)) {
+            cursor_ = it->second;
+            return true;
+        }
+        // A later entry with a colliding digest took the slot; the wanted
+        // one, if present, is older, so fall back to scanning the mapping
+        for (size_t i = it->second; i-- > 0;) {
+            if (same_entry(entry_at(i), rewind_entry)) {
+                cursor_ = i;
                 return true;
             }
-
-            cursor_.seekg(-2 * WAL_ENTRY_SIZE, ios::cur);
         }
     }
-    cursor_.clear();
-    cursor_.seekg(0, ios::beg);
-
+    cursor_ = 0;
     return false;
 }
 
+void save_wal_position(
+    std::filesystem::path const &path, WalEntry const &entry)
+{
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        os.write(
+            reinterpret_cast<char const *>(&POSITION_MAGIC),
+            sizeof(POSITION_MAGIC));
+        os.write(reinterpret_cast<char const *>(&entry), sizeof(entry));
+        MONAD_ASSERT_PRINTF(
+            os.flush(), "could not write wal position %s", tmp_path.c_str());
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+std::optional<WalEntry> load_wal_position(std::filesystem::path const &path)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        return std::nullopt;
+    }
+    uint64_t magic;
+    WalEntry entry;
+    if (!is.read(reinterpret_cast<char *>(&magic), sizeof(magic)) ||
+        magic != POSITION_MAGIC ||
+        !is.read(reinterpret_cast<char *>(&entry), sizeof(entry))) {
+        LOG_WARNING("Ignoring wal position file {} with bad contents", path);
+        return std::nullopt;
+    }
+    return entry;
+}
+
 MONAD_NAMESPACE_END
@@ -13,16 +13,25 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+
 #pragma once
 
+#include "file_io.hpp"
+
+#include <category/core/byte_string.hpp>
+#include <category/core/bytes.hpp>
 #include <category/core/config.hpp>
 #include <category/execution/monad/core/monad_block.hpp>
 
+#include <ankerl/unordered_dense.h>
 #include <evmc/evmc.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
 #include <optional>
+#include <utility>
+#include <vector>
 
 MONAD_NAMESPACE_BEGIN
 
@@ -46,25 +55,65 @@ struct WalEntry
 static_assert(sizeof(WalEntry) == 33);
 static_assert(alignof(WalEntry) == 1);
 
+/// Reads the consensus write-ahead log, an append-only array of `WalEntry`
+/// records, through a read-only mapping that is extended as the file grows.
+/// Every mapped entry is indexed by a 64-bit digest of its action and id, so
+/// `rewind_to` is a hash lookup rather than a backwards scan of the file.
 class WalReader
 {
     MonadChain const &chain_;
-    std::ifstream cursor_;
     std::filesystem::path ledger_dir_;
+    int fd_{-1};
+    unsigned char const *map_{nullptr};
+    size_t map_size_{0};
+    size_t num_entries_{0}; ///< complete entries mapped and indexed
+    size_t cursor_{0}; ///< index of the entry `next` returns
+
+    // Digest -> index of the latest entry with that digest. Keys are not
+    // unique in theory, so a hit is always compared against the entry itself.
+    ankerl::unordered_dense::map<uint64_t, size_t> index_;
+
+    byte_string header_buf_;
+    byte_string body_buf_;
+    std::vector<std::pair<byte_string, byte_string>> batch_bufs_;
+
+    void refresh();
+    WalEntry entry_at(size_t) const;
 
 public:
     struct Result
     {
         WalAction action;
-        MonadConsensusBlockHeader header;
+        bytes32_t block_id;
+        ConsensusHeader header;
         MonadConsensusBlockBody body;
     };
 
     WalReader(MonadChain const &, std::filesystem::path const &ledger_dir);
+    ~WalReader();
+
+    WalReader(WalReader const &) = delete;
+    WalReader &operator=(WalReader const &) = delete;
 
     std::optional<Result> next();
 
+    /// Returns up to `n` of the next entries, reading and decoding their
+    /// header and body files concurrently. Empty if execution got ahead.
+    std::vector<Result> next_n(size_t n);
+
+    /// Returns up to `n` of the next entries without touching the header or
+    /// body files, for callers that read those themselves
+    std::vector<WalEntry> next_entries(size_t n);
+
+    /// Positions the reader on the last occurrence of `entry`, so that the
+    /// following `next` returns it. Rewinds to the start if it is not found.
     bool rewind_to(WalEntry const &);
 };
 
+/// Records `entry` as the last WAL entry fully handled, replacing the file
+void save_wal_position(std::filesystem::path const &, WalEntry const &);
+
+/// The entry recorded by save_wal_position, if the file exists and is valid
+std::optional<WalEntry> load_wal_position(std::filesystem::path const &);
+
 MONAD_NAMESPACE_END
@@ -13,6 +13,10 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include "monad/snapshot_container.hpp"
+#include "monad/snapshot_io.hpp"
+#include "monad/state_dump.hpp"
+
 #include <category/core/assert.h>
 #include <category/core/basic_formatter.hpp> // NOLINT
 #include <category/core/byte_string.hpp>
@@ -48,6 +52,7 @@
 #include <quill/bundled/fmt/format.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <charconv>
 #include <chrono>
@@ -57,9 +62,13 @@
 #include <cstdint>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <spanstream>
@@ -786,6 +795,178 @@ int interactive_impl(Db &db)
     return 0;
 }
 
+////////////////////////////////////////
+// Binary snapshot dump
+////////////////////////////////////////
+
+// Sits between monad_db_dump_snapshot and the filesystem or container
+// writer. Every write is accounted by shard and record type for the progress
+// log and manifest, and paced when a rate limit is set.
+struct SnapshotDumpContext
+{
+    struct ShardStats
+    {
+        uint64_t bytes{0};
+        uint64_t writes{0};
+    };
+
+    void *fs_context;
+    SnapshotContainerWriter *container;
+    RateLimiter limiter;
+    std::mutex mutex{};
+    std::map<std::pair<uint64_t, unsigned>, ShardStats> shards{};
+};
+
+uint64_t write_snapshot_shard(
+    uint64_t const shard, monad_snapshot_type const type,
+    unsigned char const *const bytes, size_t const len, void *const user)
+{
+    auto &ctx = *static_cast<SnapshotDumpContext *>(user);
+    ctx.limiter.acquire(len);
+    uint64_t written = len;
+    if (ctx.container != nullptr) {
+        ctx.container->append(
+            shard, static_cast<uint32_t>(type), byte_string_view{bytes, len});
+    }
+    else {
+        written = monad_db_snapshot_write_filesystem(
+            shard, type, bytes, len, ctx.fs_context);
+    }
+    std::lock_guard const lock{ctx.mutex};
+    auto &stats = ctx.shards[{shard, static_cast<unsigned>(type)}];
+    stats.bytes += len;
+    ++stats.writes;
+    return written;
+}
+
+void write_snapshot_manifest(
+    std::filesystem::path const &dir, uint64_t const version,
+    bool const success, std::chrono::nanoseconds const elapsed,
+    SnapshotDumpContext const &ctx)
+{
+    std::string out = fmt::format(
+        "{{\n  \"version\": {},\n  \"success\": {},\n"
+        "  \"elapsed_ms\": {},\n  \"bytes\": {},\n  \"shards\": [",
+        version,
+        success,
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+        ctx.limiter.total());
+    bool first = true;
+    for (auto const &[key, stats] : ctx.shards) {
+        fmt::format_to(
+            std::back_inserter(out),
+            "{}\n    {{\"shard\": {}, \"type\": {}, \"bytes\": {}, "
+            "\"writes\": {}}}",
+            first ? "" : ",",
+            key.first,
+            key.second,
+            stats.bytes,
+            stats.writes);
+        first = false;
+    }
+    out += "\n  ]\n}\n";
+    // Next to the dump rather than in it, so that the directory holds only
+    // what the snapshot loaders expect
+    auto path = dir.has_filename() ? dir : dir.parent_path();
+    path += ".manifest.json";
+    std::ofstream os(path, std::ios::trunc);
+    os << out;
+    MONAD_ASSERT_PRINTF(
+        os.flush(), "could not write manifest %s", path.c_str());
+}
+
+// Number of container shards inserted between flushes of the db. Only
+// flushed shards are recorded in the resume log.
+constexpr size_t SNAPSHOT_SHARDS_PER_FLUSH = 16;
+
+// Inserts a chunked snapshot container with the library's shard loader; the
+// container loader reads and verifies the shards ahead of the insertion. The
+// shard loader makes its inserts durable when destroyed, so it is recreated
+// after every flush.
+uint64_t load_snapshot_container_to_db(
+    std::filesystem::path const &dir,
+    std::vector<std::filesystem::path> const &dbname_paths,
+    std::optional<unsigned> const sq_thread_cpu, uint64_t const version,
+    unsigned const num_threads, std::filesystem::path const &resume_log)
+{
+    uint64_t const container_version = read_snapshot_index(dir).version;
+    if (container_version != version) {
+        throw std::runtime_error(fmt::format(
+            "snapshot container {} is of version {}, not {}",
+            dir.string(),
+            container_version,
+            version));
+    }
+    std::vector<char const *> c_dbname_paths;
+    std::string target = fmt::format("version={}", version);
+    for (auto const &path : dbname_paths) {
+        c_dbname_paths.emplace_back(path.c_str());
+        target += ",db=" + std::filesystem::weakly_canonical(path).string();
+    }
+    bytes32_t const target_id = to_bytes(keccak256(
+        byte_string_view{
+            reinterpret_cast<unsigned char const *>(target.data()),
+            target.size()}));
+
+    monad_db_snapshot_loader *loader = nullptr;
+    std::atomic<uint64_t> bytes_loaded{0};
+    SnapshotProgress const progress{
+        "Loading snapshot container",
+        [&bytes_loaded] {
+            return bytes_loaded.load(std::memory_order_relaxed);
+        },
+        0};
+    uint64_t const inserted = load_snapshot_container(
+        dir,
+        num_threads,
+        resume_log,
+        target_id,
+        SNAPSHOT_SHARDS_PER_FLUSH,
+        [&](SnapshotShard const &shard) {
+            auto const stream = [&shard](monad_snapshot_type const type) {
+                auto const i = static_cast<size_t>(type);
+                return i < shard.streams.size()
+                           ? byte_string_view{shard.streams[i]}
+                           : byte_string_view{};
+            };
+            auto const eth_header = stream(MONAD_SNAPSHOT_ETH_HEADER);
+            auto const account = stream(MONAD_SNAPSHOT_ACCOUNT);
+            auto const storage = stream(MONAD_SNAPSHOT_STORAGE);
+            auto const code = stream(MONAD_SNAPSHOT_CODE);
+            if (loader == nullptr) {
+                loader = monad_db_snapshot_loader_create(
+                    version,
+                    c_dbname_paths.data(),
+                    c_dbname_paths.size(),
+                    sq_thread_cpu.value_or(
+                        std::numeric_limits<unsigned>::max()));
+            }
+            monad_db_snapshot_loader_load(
+                loader,
+                shard.shard,
+                eth_header.data(),
+                eth_header.size(),
+                account.data(),
+                account.size(),
+                storage.data(),
+                storage.size(),
+                code.data(),
+                code.size());
+            bytes_loaded.fetch_add(
+                eth_header.size() + account.size() + storage.size() +
+                    code.size(),
+                std::memory_order_relaxed);
+        },
+        [&loader] {
+            if (loader != nullptr) {
+                monad_db_snapshot_loader_destroy(loader);
+                loader = nullptr;
+            }
+        });
+    MONAD_ASSERT(loader == nullptr);
+    return inserted;
+}
+
 MONAD_ANONYMOUS_NAMESPACE_END
 
 int main(int argc, char *argv[])
@@ -796,6 +977,14 @@ int main(int argc, char *argv[])
     bool interactive = false;
     std::optional<std::filesystem::path> dump_binary_snapshot;
     std::optional<std::filesystem::path> load_binary_snapshot;
+    uint64_t dump_rate_limit_mbps = 0;
+    uint64_t snapshot_chunk_mb = 0;
+    bool snapshot_compress = false;
+    unsigned snapshot_load_threads = 4;
+    std::filesystem::path snapshot_load_log;
+    std::optional<std::filesystem::path> dump_state_diff;
+    uint64_t base_version;
+    unsigned dump_state_diff_threads = 4;
     uint64_t version;
 
     CLI::App cli{"monad_cli"};
@@ -822,7 +1011,31 @@ int main(int argc, char *argv[])
     auto *const dump_binary_snapshot_option = cli_group->add_option(
         "--dump_binary_snapshot",
         dump_binary_snapshot,
-        "Dump a binary snapshot to directory");
+        "Dump a binary snapshot to directory, with a manifest of the dump "
+        "written next to it as <directory>.manifest.json");
+    cli_group
+        ->add_option(
+            "--dump_rate_limit_mbps",
+            dump_rate_limit_mbps,
+            "Cap the binary snapshot dump at this many MB/s, so it can run "
+            "against a live node. Defaults to unlimited.")
+        ->needs(dump_binary_snapshot_option);
+    auto *const snapshot_chunk_mb_option =
+        cli_group
+            ->add_option(
+                "--snapshot_chunk_mb",
+                snapshot_chunk_mb,
+                "Write the binary snapshot as a chunked container of "
+                "independently checksummed chunks of this many MB, which "
+                "loads in parallel and can resume. Defaults to the plain "
+                "filesystem layout.")
+            ->needs(dump_binary_snapshot_option);
+    cli_group
+        ->add_flag(
+            "--snapshot_compress",
+            snapshot_compress,
+            "Brotli compress the chunks of a snapshot container")
+        ->needs(snapshot_chunk_mb_option);
     cli_group
         ->add_option(
             "--load_binary_snapshot",
@@ -830,6 +1043,43 @@ int main(int argc, char *argv[])
             "Load a binary snapshot to db")
         ->check(CLI::ExistingDirectory)
         ->excludes(dump_binary_snapshot_option);
+    cli_group
+        ->add_option(
+            "--snapshot_load_threads",
+            snapshot_load_threads,
+            "Number of snapshot container shards read and verified ahead of "
+            "the one being inserted")
+        ->check(CLI::Range(1u, 256u))
+        ->needs("--load_binary_snapshot");
+    cli_group
+        ->add_option(
+            "--snapshot_load_log",
+            snapshot_load_log,
+            "File recording the snapshot container shards durably loaded "
+            "into --db, so that an interrupted load resumes where it "
+            "stopped. Keep it with the db; it is ignored for another "
+            "container or db.")
+        ->needs("--load_binary_snapshot");
+    auto *const dump_state_diff_option =
+        cli_group
+            ->add_option(
+                "--dump_state_diff",
+                dump_state_diff,
+                "Dump the state that changed between --base_version and "
+                "--version as ndjson, for loading with monad --snapshot_diff")
+            ->excludes(dump_binary_snapshot_option);
+    cli_group
+        ->add_option(
+            "--base_version", base_version, "Base version of the state diff")
+        ->needs(dump_state_diff_option);
+    dump_state_diff_option->needs("--base_version");
+    cli_group
+        ->add_option(
+            "--dump_state_diff_threads",
+            dump_state_diff_threads,
+            "Number of threads walking the tries for --dump_state_diff")
+        ->check(CLI::Range(1u, 256u))
+        ->needs(dump_state_diff_option);
     mode_group->require_option(0, 1);
     try {
         cli.parse(argc, argv);
@@ -882,14 +1132,41 @@ int main(int argc, char *argv[])
         for (auto const &path : dbname_paths) {
             c_dbname_paths.emplace_back(path.c_str());
         }
-        [[maybe_unused]] auto const begin = std::chrono::steady_clock::now();
-        bool const success = monad_db_dump_snapshot(
-            c_dbname_paths.data(),
-            c_dbname_paths.size(),
-            sq_thread_cpu.value_or(std::numeric_limits<unsigned>::max()),
+        std::optional<SnapshotContainerWriter> container;
+        if (snapshot_chunk_mb != 0) {
+            container.emplace(
+                dump_binary_snapshot.value(),
+                version,
+                snapshot_chunk_mb << 20,
+                snapshot_compress ? ChunkCodec::Brotli : ChunkCodec::None);
+        }
+        SnapshotDumpContext dump_context{
+            .fs_context = context,
+            .container = container.has_value() ? &container.value() : nullptr,
+            .limiter = RateLimiter{dump_rate_limit_mbps << 20}};
+        auto const begin = std::chrono::steady_clock::now();
+        bool const success = [&] {
+            SnapshotProgress const progress{
+                "Dumping snapshot",
+                [&dump_context] { return dump_context.limiter.total(); },
+                0};
+            return monad_db_dump_snapshot(
+                c_dbname_paths.data(),
+                c_dbname_paths.size(),
+                sq_thread_cpu.value_or(std::numeric_limits<unsigned>::max()),
+                version,
+                write_snapshot_shard,
+                &dump_context);
+        }();
+        if (success && container.has_value()) {
+            container->finish();
+        }
+        write_snapshot_manifest(
+            dump_binary_snapshot.value(),
             version,
-            monad_db_snapshot_write_filesystem,
-            context);
+            success,
+            std::chrono::steady_clock::now() - begin,
+            dump_context);
         LOG_INFO(
             "snapshot dump success={} version={} directory={} elapsed={}",
             success,
@@ -899,6 +1176,41 @@ int main(int argc, char *argv[])
         monad_db_snapshot_filesystem_write_user_context_destroy(context);
         return success == false;
     }
+    else if (dump_state_diff.has_value()) {
+        auto const begin = std::chrono::steady_clock::now();
+        dump_state_diff_ndjson(
+            ReadOnlyOnDiskDbConfig{
+                .sq_thread_cpu = sq_thread_cpu, .dbname_paths = dbname_paths},
+            dump_state_diff.value(),
+            base_version,
+            version,
+            dump_state_diff_threads);
+        LOG_INFO(
+            "state diff base_version={} version={} directory={} elapsed={}",
+            base_version,
+            version,
+            dump_state_diff.value(),
+            std::chrono::steady_clock::now() - begin);
+    }
+    else if (
+        load_binary_snapshot.has_value() &&
+        is_snapshot_container(load_binary_snapshot.value())) {
+        auto const begin = std::chrono::steady_clock::now();
+        uint64_t const shards = load_snapshot_container_to_db(
+            load_binary_snapshot.value(),
+            dbname_paths,
+            sq_thread_cpu,
+            version,
+            snapshot_load_threads,
+            snapshot_load_log);
+        LOG_INFO(
+            "snapshot version={} load_binary_snapshot={} shards={} "
+            "elapsed={}",
+            version,
+            load_binary_snapshot.value(),
+            shards,
+            std::chrono::steady_clock::now() - begin);
+    }
     else if (load_binary_snapshot.has_value()) {
         std::vector<char const *> c_dbname_paths;
         for (auto const &path : dbname_paths) {
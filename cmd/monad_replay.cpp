@@ -0,0 +1,377 @@
+// Copyright (C) 2025 Category Labs, Inc.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Replays a historical block range as several independent `monad` processes,
+// one per sub-range between consecutive checkpoints written by
+// `monad --checkpoint_every`. Each range is loaded from its checkpoint with
+// `monad_cli --load_binary_snapshot`, replayed (which checks every block's
+// state root against its header), and finally the state root each range
+// ends on is checked against the root of the checkpoint the next range
+// starts from.
+
+#include <category/core/assert.h>
+#include <category/core/basic_formatter.hpp> // NOLINT
+#include <category/core/bytes.hpp>
+#include <category/core/config.hpp>
+#include <category/execution/ethereum/core/fmt/bytes_fmt.hpp> // NOLINT
+#include <category/execution/ethereum/core/log_level_map.hpp>
+#include <category/execution/ethereum/db/trie_db.hpp>
+#include <category/mpt/db.hpp>
+#include <category/mpt/ondisk_db_config.hpp>
+
+#include <CLI/CLI.hpp>
+#include <quill/Quill.h>
+#include <quill/bundled/fmt/core.h>
+#include <quill/bundled/fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+using namespace monad;
+using namespace monad::mpt;
+
+MONAD_ANONYMOUS_NAMESPACE_BEGIN
+
+struct ReplayRange
+{
+    uint64_t snapshot; ///< block the range starts from, 0 for genesis
+    uint64_t last; ///< last block replayed
+    std::filesystem::path dir;
+
+    bool ok{false};
+    std::string error{};
+    std::optional<bytes32_t> start_root{};
+    std::optional<bytes32_t> end_root{};
+    std::chrono::seconds elapsed{0};
+};
+
+struct ReplayConfig
+{
+    std::filesystem::path monad;
+    std::filesystem::path monad_cli;
+    std::filesystem::path block_db;
+    std::filesystem::path snapshot_dir;
+    std::string chain;
+    uint64_t db_size_gb;
+    bool keep_dbs;
+    std::vector<std::string> monad_args;
+};
+
+// Runs `args` to completion with its output appended to `log`; returns the
+// exit status, or -1 if it did not exit normally
+int run_process(
+    std::vector<std::string> const &args, std::filesystem::path const &log)
+{
+    LOG_INFO(
+        "Running {} > {}", fmt::format("{}", fmt::join(args, " ")), log);
+    std::vector<char *> argv;
+    for (auto const &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(
+        &actions,
+        STDOUT_FILENO,
+        log.c_str(),
+        O_WRONLY | O_CREAT | O_APPEND,
+        0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t pid;
+    int const rc =
+        posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    MONAD_ASSERT_PRINTF(
+        rc == 0, "could not start %s: %s", argv[0], strerror(rc));
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        MONAD_ASSERT_PRINTF(
+            errno == EINTR, "waitpid failed: %s", strerror(errno));
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// State root of `version`, and the latest finalized version, of the db in
+// `db_path`
+std::pair<bytes32_t, uint64_t>
+read_state_root(std::filesystem::path const &db_path, uint64_t const version)
+{
+    AsyncIOContext io_ctx{ReadOnlyOnDiskDbConfig{.dbname_paths = {db_path}}};
+    Db ro_db{io_ctx};
+    TrieDb triedb{ro_db};
+    triedb.set_block_and_prefix(version);
+    return {triedb.state_root(), ro_db.get_latest_finalized_version()};
+}
+
+void replay_range(ReplayConfig const &config, ReplayRange &range)
+{
+    auto const begin = std::chrono::steady_clock::now();
+    std::filesystem::create_directories(range.dir);
+    auto const db_path = range.dir / "db";
+    {
+        std::ofstream const create(db_path, std::ios::trunc);
+    }
+    std::filesystem::resize_file(db_path, config.db_size_gb << 30);
+
+    if (range.snapshot != 0) {
+        int const status = run_process(
+            {config.monad_cli.string(),
+             "--db",
+             db_path.string(),
+             "--load_binary_snapshot",
+             (config.snapshot_dir / std::to_string(range.snapshot)).string(),
+             "--version",
+             std::to_string(range.snapshot)},
+            range.dir / "load.log");
+        if (status != 0) {
+            range.error = fmt::format("snapshot load exited with {}", status);
+            return;
+        }
+        range.start_root = read_state_root(db_path, range.snapshot).first;
+    }
+
+    std::vector<std::string> args{
+        config.monad.string(),
+        "--chain",
+        config.chain,
+        "--block_db",
+        config.block_db.string(),
+        "--db",
+        db_path.string(),
+        "--nblocks",
+        std::to_string(range.last - range.snapshot)};
+    args.insert(args.end(), config.monad_args.begin(), config.monad_args.end());
+    int const status = run_process(args, range.dir / "replay.log");
+    range.elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - begin);
+    if (status != 0) {
+        range.error = fmt::format("replay exited with {}", status);
+        return;
+    }
+    auto const [end_root, finalized] = read_state_root(db_path, range.last);
+    if (finalized != range.last) {
+        range.error = fmt::format("replay stopped at block {}", finalized);
+        return;
+    }
+    range.end_root = end_root;
+    range.ok = true;
+    if (!config.keep_dbs) {
+        std::filesystem::remove(db_path);
+    }
+}
+
+// Checkpoints are directories named after the block they were taken at;
+// ones still being written end in .tmp and are skipped
+std::vector<uint64_t> list_snapshots(std::filesystem::path const &dir)
+{
+    std::vector<uint64_t> blocks;
+    for (auto const &entry : std::filesystem::directory_iterator{dir}) {
+        std::string const name = entry.path().filename().string();
+        if (entry.is_directory() && !name.empty() &&
+            std::ranges::all_of(name, ::isdigit)) {
+            blocks.push_back(std::stoull(name));
+        }
+    }
+    std::ranges::sort(blocks);
+    return blocks;
+}
+
+MONAD_ANONYMOUS_NAMESPACE_END
+
+int main(int argc, char *argv[])
+{
+    ReplayConfig config{
+        .monad = std::filesystem::path{argv[0]}.parent_path() / "monad",
+        .monad_cli = std::filesystem::path{argv[0]}.parent_path() / "monad_cli",
+        .block_db = {},
+        .snapshot_dir = {},
+        .chain = "ethereum_mainnet",
+        .db_size_gb = 512,
+        .keep_dbs = false,
+        .monad_args = {}};
+    std::filesystem::path work_dir;
+    uint64_t start_block = 0;
+    uint64_t end_block;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency() / 8);
+    auto log_level = quill::LogLevel::Info;
+
+    CLI::App cli{"monad_replay"};
+    cli.add_option("--block_db", config.block_db, "block_db directory")
+        ->required();
+    cli.add_option(
+           "--snapshots",
+           config.snapshot_dir,
+           "directory of checkpoints written by monad --checkpoint_every")
+        ->check(CLI::ExistingDirectory)
+        ->required();
+    cli.add_option(
+           "--work_dir",
+           work_dir,
+           "directory for the per-range dbs and logs")
+        ->required();
+    cli.add_option(
+        "--start",
+        start_block,
+        "block the replay starts from; 0 for genesis or a checkpoint");
+    cli.add_option("--end", end_block, "last block to replay")->required();
+    cli.add_option(
+        "--jobs", jobs, "number of ranges replayed at the same time");
+    cli.add_option("--chain", config.chain, "chain config passed to monad");
+    cli.add_option("--monad", config.monad, "path to the monad binary");
+    cli.add_option(
+        "--monad_cli", config.monad_cli, "path to the monad_cli binary");
+    cli.add_option(
+        "--db_size_gb",
+        config.db_size_gb,
+        "size of the sparse db file created for each range");
+    cli.add_flag(
+        "--keep_dbs",
+        config.keep_dbs,
+        "keep the db of each range that replayed successfully");
+    cli.add_option("--log_level", log_level, "level of logging")
+        ->transform(CLI::CheckedTransformer(log_level_map, CLI::ignore_case));
+    cli.allow_extras();
+    cli.footer("Arguments after -- are passed on to every monad replay");
+    try {
+        cli.parse(argc, argv);
+    }
+    catch (CLI::ParseError const &e) {
+        return cli.exit(e);
+    }
+    config.monad_args = cli.remaining();
+
+    auto stdout_handler = quill::stdout_handler();
+    stdout_handler->set_pattern(
+        "%(time) [%(thread_id)] %(file_name):%(line_number) LOG_%(log_level)\t"
+        "%(message)",
+        "%Y-%m-%d %H:%M:%S.%Qns",
+        quill::Timezone::GmtTime);
+    quill::Config cfg;
+    cfg.default_handlers.emplace_back(stdout_handler);
+    quill::configure(cfg);
+    quill::start(true);
+    quill::get_root_logger()->set_log_level(log_level);
+
+    std::vector<uint64_t> const snapshots = list_snapshots(config.snapshot_dir);
+    if (start_block != 0 &&
+        !std::ranges::binary_search(snapshots, start_block)) {
+        fmt::println(
+            stderr,
+            "No checkpoint of block {} in {}",
+            start_block,
+            config.snapshot_dir.string());
+        return EXIT_FAILURE;
+    }
+    if (end_block <= start_block) {
+        fmt::println(stderr, "--end must be after --start");
+        return EXIT_FAILURE;
+    }
+    std::vector<ReplayRange> ranges;
+    uint64_t first = start_block;
+    for (uint64_t const snapshot : snapshots) {
+        if (snapshot > first && snapshot < end_block) {
+            ranges.push_back(ReplayRange{
+                .snapshot = first,
+                .last = snapshot,
+                .dir = work_dir / fmt::format("{}-{}", first, snapshot)});
+            first = snapshot;
+        }
+    }
+    ranges.push_back(ReplayRange{
+        .snapshot = first,
+        .last = end_block,
+        .dir = work_dir / fmt::format("{}-{}", first, end_block)});
+    LOG_INFO(
+        "Replaying blocks {} to {} as {} ranges, {} at a time",
+        start_block + 1,
+        end_block,
+        ranges.size(),
+        jobs);
+
+    auto const begin = std::chrono::steady_clock::now();
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::jthread> workers;
+        for (unsigned i = 0; i < std::min<size_t>(jobs, ranges.size()); ++i) {
+            workers.emplace_back([&] {
+                for (size_t j = next++; j < ranges.size(); j = next++) {
+                    replay_range(config, ranges[j]);
+                    LOG_INFO(
+                        "Range {}-{} {} in {}",
+                        ranges[j].snapshot,
+                        ranges[j].last,
+                        ranges[j].ok ? "replayed" : ranges[j].error,
+                        ranges[j].elapsed);
+                }
+            });
+        }
+    }
+
+    bool ok = true;
+    fmt::println(
+        "{:>23}  {:>8}  {:<66}  {}", "blocks", "time", "end root", "status");
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        ReplayRange const &range = ranges[i];
+        std::string status = range.ok ? "ok" : range.error;
+        // The next range starts from a checkpoint taken by an earlier run;
+        // its root must be where this range ended
+        if (range.ok && i + 1 < ranges.size() &&
+            ranges[i + 1].start_root.has_value() &&
+            ranges[i + 1].start_root != range.end_root) {
+            status = fmt::format(
+                "does not stitch: next range starts from {}",
+                ranges[i + 1].start_root.value());
+        }
+        ok = ok && status == "ok";
+        fmt::println(
+            "{:>23}  {:>8}  {:<66}  {}",
+            fmt::format("{}-{}", range.snapshot + 1, range.last),
+            fmt::format("{}s", range.elapsed.count()),
+            range.end_root.has_value() ? fmt::format("{}", *range.end_root)
+                                       : "-",
+            status);
+    }
+    fmt::println(
+        "{} in {}s",
+        ok ? "All ranges replayed and stitched" : "Replay FAILED",
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - begin)
+            .count());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}